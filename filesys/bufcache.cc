@@ -0,0 +1,492 @@
+// bufcache.cc
+//	Routines to cache disk sectors in memory, in front of the disk.
+//
+//	All the bookkeeping is protected by one lock.  The lock is never
+//	held across disk I/O; instead the buffer being read or written is
+//	marked busy, which keeps every other thread away from it until
+//	the I/O is done.
+
+#include "copyright.h"
+#include "bufcache.h"
+#include "synchdisk.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ReadAheadThread
+// 	Body of the read-ahead kernel thread.  Need this to be a C routine,
+//	because Thread::Fork can't take a pointer to a member function.
+//----------------------------------------------------------------------
+
+static void
+ReadAheadThread(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    cache->ReadAheadDaemon();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::BufferCache
+// 	Initialize a cache with no sectors in it.
+//
+//	"disk" -- where to read misses from and write dirty sectors to
+//----------------------------------------------------------------------
+
+BufferCache::BufferCache(SynchDisk *theDisk)
+{
+    disk = theDisk;
+    lock = new Lock("buffer cache lock");
+    bufferFree = new Condition("buffer free");
+    buffers = new CacheBuffer[CacheSize];
+    for (int i = 0; i < CacheHashSize; i++)
+	hash[i] = NULL;
+    lruHead = lruTail = NULL;
+    for (int i = 0; i < CacheSize; i++) {
+	CacheBuffer *buf = &buffers[i];
+
+	buf->sector = -1;
+	buf->valid = buf->dirty = buf->busy = buf->pinned = FALSE;
+	buf->hashNext = NULL;
+	buf->lruPrev = lruTail;		// append to the LRU list
+	buf->lruNext = NULL;
+	if (lruTail != NULL)
+	    lruTail->lruNext = buf;
+	else
+	    lruHead = buf;
+	lruTail = buf;
+    }
+
+    readAheadWanted = new Condition("read ahead wanted");
+    readAheadFirst = readAheadCount = 0;
+    Thread *t = new Thread("read ahead");
+    t->Fork(ReadAheadThread, (int) this);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::~BufferCache
+// 	Write back anything that is dirty and not pinned, and de-allocate
+//	the cache.
+//
+//	This happens while Nachos is halting, usually from Interrupt::Idle
+//	with no thread able to run, so we cannot wait for disk interrupts
+//	the way Sync does.
+//
+//	Pinned buffers are left out: their changes belong to transactions
+//	the journal has not committed, and must not reach their home
+//	sectors until it has.  Whatever was committed is replayed from the
+//	log at the next boot.
+//----------------------------------------------------------------------
+
+BufferCache::~BufferCache()
+{
+    for (int i = 0; i < CacheSize; i++)
+	if (buffers[i].dirty && !buffers[i].pinned)
+	    disk->WriteAtShutdown(buffers[i].sector, buffers[i].data);
+    delete [] buffers;
+    delete bufferFree;
+    delete readAheadWanted;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Read
+// 	Copy the contents of a sector into "data".  On a miss, the sector
+//	is read from disk into a buffer first.
+//
+//	"sector" -- the disk sector to read
+//	"data" -- the buffer to hold the contents of the disk sector
+//----------------------------------------------------------------------
+
+void
+BufferCache::Read(int sector, char *data)
+{
+    CacheBuffer *buf;
+
+    lock->Acquire();
+    buf = Get(sector, TRUE);
+    if (buf->valid)
+	stats->numCacheHits++;
+    else
+	stats->numCacheMisses++;
+    lock->Release();
+
+    if (!buf->valid) {			// the buffer is ours while busy
+	disk->ReadUncached(sector, 1, buf->data);
+	buf->valid = TRUE;
+    }
+    bcopy(buf->data, data, SectorSize);
+
+    lock->Acquire();
+    Put(buf);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Write
+// 	Copy "data" into the buffer for a sector, and mark it dirty.  The
+//	disk is not touched until the buffer is recycled or synced.
+//
+//	"sector" -- the disk sector to be written
+//	"data" -- the new contents of the disk sector
+//	"pin" -- keep the buffer in the cache, and off the disk, until
+//	   Unpin is called for it
+//----------------------------------------------------------------------
+
+void
+BufferCache::Write(int sector, char *data, bool pin)
+{
+    CacheBuffer *buf;
+
+    lock->Acquire();
+    buf = Get(sector, TRUE);
+    if (buf->valid)
+	stats->numCacheHits++;
+    else
+	stats->numCacheMisses++;	// whole sector, so no need to read
+    lock->Release();
+
+    bcopy(data, buf->data, SectorSize);
+    buf->valid = TRUE;
+    buf->dirty = TRUE;
+
+    lock->Acquire();
+    if (pin)
+	buf->pinned = TRUE;
+    Put(buf);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Unpin
+// 	The journal has committed the change to "sector"; its buffer may
+//	now be written home and recycled like any other.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Unpin(int sector)
+{
+    CacheBuffer *buf;
+
+    lock->Acquire();
+    buf = Lookup(sector);
+    if (buf != NULL && buf->pinned) {
+	buf->pinned = FALSE;
+	bufferFree->Broadcast(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadSectors
+// 	Copy several sectors out of the cache into consecutive pieces of
+//	"data".  When a sector misses, the sectors right after it on disk
+//	that are also wanted next, and are not cached, are read from disk
+//	together with it, straight into "data", and then copied into
+//	their buffers.
+//
+//	While we hold buffers for a run, we do not wait for any more: if
+//	no buffer can be had right away, the run just ends there.
+//
+//	"sectors" -- the disk sectors to read, in order
+//	"numSectors" -- how many there are
+//	"data" -- the buffer to hold the contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadSectors(int *sectors, int numSectors, char *data)
+{
+    CacheBuffer *run[MaxRunSectors];
+    int i = 0, n;
+
+    while (i < numSectors) {
+	lock->Acquire();
+	run[0] = Get(sectors[i], TRUE);
+	if (run[0]->valid) {
+	    stats->numCacheHits++;
+	    lock->Release();
+	    bcopy(run[0]->data, &data[i * SectorSize], SectorSize);
+	    lock->Acquire();
+	    Put(run[0]);
+	    lock->Release();
+	    i++;
+	    continue;
+	}
+	for (n = 1; n < MaxRunSectors && i + n < numSectors
+		    && sectors[i + n] == sectors[i] + n; n++) {
+	    CacheBuffer *buf = Get(sectors[i + n], FALSE);
+
+	    if (buf == NULL)
+		break;
+	    if (buf->valid) {		// cached: read it on its own later
+		Put(buf);
+		break;
+	    }
+	    run[n] = buf;
+	}
+	stats->numCacheMisses += n;
+	lock->Release();
+
+	disk->ReadUncached(sectors[i], n, &data[i * SectorSize]);
+	for (int k = 0; k < n; k++) {
+	    bcopy(&data[(i + k) * SectorSize], run[k]->data, SectorSize);
+	    run[k]->valid = TRUE;
+	}
+
+	lock->Acquire();
+	for (int k = 0; k < n; k++)
+	    Put(run[k]);
+	lock->Release();
+	i += n;
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Sync
+// 	Write every dirty buffer back to disk, lowest sector first, so
+//	that dirty buffers for consecutive sectors go out as one request.
+//	Buffers that are busy are waited for, so that everything written
+//	before the call is on disk when it returns -- except for pinned
+//	buffers, which are left for the journal to unpin.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Sync()
+{
+    CacheBuffer *run[MaxRunSectors];
+    char *data = new char[MaxRunSectors * SectorSize];
+    CacheBuffer *first, *buf;
+    bool busyDirty;
+    int n;
+
+    lock->Acquire();
+    for (;;) {
+	first = NULL;
+	busyDirty = FALSE;
+	for (int i = 0; i < CacheSize; i++) {
+	    buf = &buffers[i];
+	    if (!buf->dirty || buf->pinned)
+		continue;
+	    if (buf->busy)
+		busyDirty = TRUE;
+	    else if (first == NULL || buf->sector < first->sector)
+		first = buf;
+	}
+	if (first == NULL) {
+	    if (!busyDirty)
+		break;			// all clean
+	    bufferFree->Wait(lock);
+	    continue;
+	}
+
+	run[0] = first;
+	first->busy = TRUE;
+	for (n = 1; n < MaxRunSectors; n++) {
+	    buf = Lookup(first->sector + n);
+	    if (buf == NULL || !buf->dirty || buf->busy || buf->pinned)
+		break;
+	    buf->busy = TRUE;
+	    run[n] = buf;
+	}
+	lock->Release();
+
+	for (int k = 0; k < n; k++)
+	    bcopy(run[k]->data, &data[k * SectorSize], SectorSize);
+	disk->WriteUncached(first->sector, n, data);
+
+	lock->Acquire();
+	for (int k = 0; k < n; k++) {
+	    run[k]->dirty = FALSE;
+	    run[k]->busy = FALSE;
+	}
+	bufferFree->Broadcast(lock);
+    }
+    lock->Release();
+    delete [] data;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadAhead
+// 	Queue "sector" to be read into the cache by the read-ahead
+//	thread, and return without waiting.  This is only a hint: it is
+//	dropped if the sector is already cached, or if too many requests
+//	are queued already.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadAhead(int sector)
+{
+    lock->Acquire();
+    if (Lookup(sector) == NULL && readAheadCount < ReadAheadQueueSize) {
+	readAheadQueue[(readAheadFirst + readAheadCount) % ReadAheadQueueSize]
+	    = sector;
+	readAheadCount++;
+	readAheadWanted->Signal(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadAheadDaemon
+// 	Loop forever, reading queued sectors into the cache.  Sectors
+//	that have been cached in the meantime are skipped.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadAheadDaemon()
+{
+    CacheBuffer *buf;
+    int sector;
+
+    lock->Acquire();
+    for (;;) {
+	while (readAheadCount == 0)
+	    readAheadWanted->Wait(lock);
+	sector = readAheadQueue[readAheadFirst];
+	readAheadFirst = (readAheadFirst + 1) % ReadAheadQueueSize;
+	readAheadCount--;
+
+	buf = Get(sector, TRUE);
+	if (!buf->valid) {
+	    stats->numReadAheads++;
+	    lock->Release();
+	    disk->ReadUncached(sector, 1, buf->data);
+	    lock->Acquire();
+	    buf->valid = TRUE;
+	}
+	Put(buf);
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Lookup
+// 	Return the buffer holding "sector", or NULL if it isn't cached.
+//	The caller must hold the lock.
+//----------------------------------------------------------------------
+
+CacheBuffer *
+BufferCache::Lookup(int sector)
+{
+    CacheBuffer *buf;
+
+    for (buf = hash[sector % CacheHashSize]; buf != NULL; buf = buf->hashNext)
+	if (buf->sector == sector)
+	    return buf;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Get
+// 	Claim (mark busy) the buffer for "sector".  If the sector is not
+//	cached, recycle the least recently used buffer that is neither
+//	busy nor pinned; its "valid" flag is then FALSE.  A dirty buffer is written back
+//	before it is recycled.
+//
+//	The caller must hold the lock; it may be released and re-acquired
+//	while waiting, so everything is looked up again each time around.
+//	If "mayWait" is FALSE, the lock is never released: we return NULL
+//	if the buffer is busy, or if there is no clean buffer to recycle.
+//----------------------------------------------------------------------
+
+CacheBuffer *
+BufferCache::Get(int sector, bool mayWait)
+{
+    CacheBuffer *buf;
+
+    for (;;) {
+	buf = Lookup(sector);
+	if (buf != NULL) {
+	    if (!buf->busy) {
+		buf->busy = TRUE;
+		return buf;
+	    }
+	    if (!mayWait)
+		return NULL;
+	    bufferFree->Wait(lock);	// someone else is using it
+	    continue;
+	}
+
+	for (buf = lruTail; buf != NULL; buf = buf->lruPrev)
+	    if (!buf->busy && !buf->pinned && (mayWait || !buf->dirty))
+		break;
+	if (buf == NULL) {		// every buffer is busy or pinned
+	    if (!mayWait)
+		return NULL;
+	    bufferFree->Wait(lock);
+	    continue;
+	}
+	if (buf->dirty) {		// write back, then start over
+	    buf->busy = TRUE;
+	    lock->Release();
+	    disk->WriteUncached(buf->sector, 1, buf->data);
+	    lock->Acquire();
+	    buf->dirty = FALSE;
+	    buf->busy = FALSE;
+	    bufferFree->Broadcast(lock);
+	    continue;
+	}
+
+	Unhash(buf);
+	buf->sector = sector;
+	buf->valid = FALSE;
+	buf->busy = TRUE;
+	buf->hashNext = hash[sector % CacheHashSize];
+	hash[sector % CacheHashSize] = buf;
+	return buf;
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Put
+// 	Release a buffer claimed by Get; it becomes the most recently
+//	used one.  The caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Put(CacheBuffer *buf)
+{
+    buf->busy = FALSE;
+    MoveToFront(buf);
+    bufferFree->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Unhash
+// 	Take a buffer out of its hash bucket, if it is in one.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Unhash(CacheBuffer *buf)
+{
+    CacheBuffer **link;
+
+    if (buf->sector < 0)
+	return;
+    for (link = &hash[buf->sector % CacheHashSize]; *link != NULL;
+					link = &(*link)->hashNext)
+	if (*link == buf) {
+	    *link = buf->hashNext;
+	    break;
+	}
+    buf->hashNext = NULL;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::MoveToFront
+// 	Make "buf" the most recently used buffer.
+//----------------------------------------------------------------------
+
+void
+BufferCache::MoveToFront(CacheBuffer *buf)
+{
+    if (buf == lruHead)
+	return;
+    buf->lruPrev->lruNext = buf->lruNext;	// unlink; buf isn't the head
+    if (buf->lruNext != NULL)
+	buf->lruNext->lruPrev = buf->lruPrev;
+    else
+	lruTail = buf->lruPrev;
+    buf->lruPrev = NULL;
+    buf->lruNext = lruHead;
+    lruHead->lruPrev = buf;
+    lruHead = buf;
+}
@@ -0,0 +1,103 @@
+// bufcache.h
+//	Data structures for the kernel's cache of disk sectors.
+//
+//	SynchDisk::ReadSector and WriteSector go through this cache, so
+//	the file system's repeated reads of file headers, directories and
+//	the free map are normally served from memory.  Writes are
+//	delayed: a sector is only written to disk when its buffer is
+//	reused for another sector, or when Sync is called.
+//
+//	Buffers are found through a hash table on the sector number, and
+//	replaced in least recently used order.  A buffer is "busy" while
+//	one thread is copying data into or out of it, or doing disk I/O
+//	for it; anyone else who wants that buffer waits.
+//
+//	A buffer can be "pinned" by the metadata journal: it holds a change
+//	that is not committed yet, so it must not be written home; it is
+//	neither recycled nor synced until the journal unpins it.
+//
+//	ReadAhead lets a file that is being read sequentially ask for
+//	sectors it will probably want soon.  They are read into the cache
+//	by a kernel thread, so the reader keeps running while the disk
+//	works, and finds them there later.
+
+#ifndef BUFCACHE_H
+#define BUFCACHE_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "synch.h"
+
+#define CacheSize	64		// number of sector buffers
+#define CacheHashSize	61		// number of hash buckets
+#define ReadAheadQueueSize 32		// read-ahead requests not yet started
+#define MaxRunSectors	16		// most sectors moved in one request
+
+class SynchDisk;
+
+// One sector's worth of cached data.
+class CacheBuffer {
+  public:
+    int sector;				// which sector, -1 if none
+    bool valid;				// data holds the sector's contents
+    bool dirty;				// data is newer than the disk
+    bool busy;				// in use by some thread
+    bool pinned;			// held in the cache by the journal
+    char data[SectorSize];
+
+    CacheBuffer *hashNext;		// next buffer in the same bucket
+    CacheBuffer *lruPrev;		// more recently used buffer
+    CacheBuffer *lruNext;		// less recently used buffer
+};
+
+// The following class defines the cache itself.
+class BufferCache {
+  public:
+    BufferCache(SynchDisk *disk);	// an empty cache in front of "disk"
+    ~BufferCache();			// write back dirty buffers at
+					// shutdown, then de-allocate
+
+    void Read(int sector, char *data);	// copy a sector out of the cache,
+					// reading it from disk on a miss
+    void Write(int sector, char *data, bool pin);
+					// copy a sector into the cache;
+					// it is written back later, but
+					// not before Unpin if "pin"
+    void Unpin(int sector);		// let a pinned sector go home
+    void ReadSectors(int *sectors, int numSectors, char *data);
+					// Read of several sectors; misses on
+					// consecutive sectors are read from
+					// disk in one request
+    void Sync();			// write back every dirty buffer
+
+    void ReadAhead(int sector);		// start bringing "sector" into the
+					// cache in the background
+    void ReadAheadDaemon();		// body of the read-ahead thread
+
+  private:
+    SynchDisk *disk;			// where misses and write-backs go
+    CacheBuffer *buffers;		// all CacheSize buffers
+    CacheBuffer *hash[CacheHashSize];	// buckets, chained by hashNext
+    CacheBuffer *lruHead;		// most recently used
+    CacheBuffer *lruTail;		// least recently used
+    Lock *lock;				// protects everything above
+    Condition *bufferFree;		// signalled when a buffer stops
+					// being busy
+    int readAheadQueue[ReadAheadQueueSize];
+					// sectors waiting to be read ahead
+    int readAheadFirst;			// oldest queued request
+    int readAheadCount;			// number of queued requests
+    Condition *readAheadWanted;		// signalled when one is queued
+
+    CacheBuffer *Lookup(int sector);	// buffer holding sector, or NULL
+    CacheBuffer *Get(int sector, bool mayWait);
+					// claim the buffer for sector,
+					// recycling one if needed; if
+					// !mayWait, return NULL rather than
+					// wait or write anything back
+    void Put(CacheBuffer *buf);		// done with a claimed buffer
+    void Unhash(CacheBuffer *buf);
+    void MoveToFront(CacheBuffer *buf);	// mark as most recently used
+};
+
+#endif // BUFCACHE_H
@@ -0,0 +1,240 @@
+// defrag.cc
+//	Routines to move the data of fragmented files into consecutive
+//	sectors, in the background (cf. defrag.h).
+//
+//	Locks are taken in the order given in filesys.cc: the journal
+//	handle, then the file's lock, then the free map.  A directory is
+//	only locked long enough to read it and open what is in it; once
+//	open, nothing in it can be removed under us.
+
+#include "copyright.h"
+#include "defrag.h"
+#include "directory.h"
+#include "filehdr.h"
+#include "filesys.h"
+#include "journal.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// DefragThread
+// 	Body of the defragmenting thread.  Need this to be a C routine,
+//	because Thread::Fork can't take a pointer to a member function.
+//----------------------------------------------------------------------
+
+static void
+DefragThread(int arg)
+{
+    Defragmenter *defrag = (Defragmenter *) arg;
+
+    defrag->Run();
+    delete defrag;
+}
+
+//----------------------------------------------------------------------
+// CountExtents
+// 	Return how many runs of consecutive disk sectors the data of the
+//	file with header "hdr" is in, and set "numData" to how many data
+//	sectors it has, not counting holes.  The caller holds the file's
+//	lock.
+//----------------------------------------------------------------------
+
+static int
+CountExtents(FileHeader *hdr, int *numData)
+{
+    int numSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int extents = 0, last = -1;
+
+    *numData = 0;
+    for (int i = 0; i < numSectors; i++) {
+	int sector = hdr->ByteToSector(i * SectorSize);
+
+	if (sector == 0)
+	    continue;			// a hole
+	if (sector != last + 1)
+	    extents++;
+	last = sector;
+	(*numData)++;
+    }
+    return extents;
+}
+
+//----------------------------------------------------------------------
+// Defragmenter::Defragmenter
+// 	Start a thread to defragment the whole file system, once.
+//----------------------------------------------------------------------
+
+Defragmenter::Defragmenter()
+{
+    Thread *t = new Thread("defragmenter");
+
+    numFiles = numSectors = 0;
+    t->Fork(DefragThread, (int) this);
+}
+
+//----------------------------------------------------------------------
+// Defragmenter::Run
+// 	Defragment the root directory and everything below it.
+//----------------------------------------------------------------------
+
+void
+Defragmenter::Run()
+{
+    OpenFile *root = new OpenFile(DirectorySector);
+
+    DEBUG('D', "Defragmenter starting\n");
+    DefragFile(root);
+    DefragDirectory(root);
+    delete root;
+    DEBUG('D', "Defragmenter done: moved %d sectors of %d files\n",
+							numSectors, numFiles);
+}
+
+//----------------------------------------------------------------------
+// Defragmenter::DefragDirectory
+// 	Defragment every file in directory "dir", and every directory
+//	below it.  Everything in it is opened while the directory is
+//	locked, so that it stays there until we are done with it.
+//----------------------------------------------------------------------
+
+void
+Defragmenter::DefragDirectory(OpenFile *dir)
+{
+    RWLock *dirLock = headerTable->DirLock(dir->sector);
+    DirectoryEntry *table;
+    OpenFile **files;
+    int numEntries;
+
+    dirLock->Acquire_r();
+    numEntries = dir->Length() / sizeof(DirectoryEntry);
+    table = new DirectoryEntry[numEntries];
+    dir->ReadAt((char *) table, numEntries * sizeof(DirectoryEntry), 0);
+    files = new OpenFile *[numEntries];
+    for (int i = 0; i < numEntries; i++)
+	files[i] = table[i].inUse ? new OpenFile(table[i].sector) : NULL;
+    dirLock->Release_r();
+
+    for (int i = 0; i < numEntries; i++) {
+	if (files[i] == NULL)
+	    continue;
+	DefragFile(files[i]);
+	if (table[i].type == 0)		// a directory
+	    DefragDirectory(files[i]);
+	delete files[i];
+    }
+    delete [] files;
+    delete [] table;
+}
+
+//----------------------------------------------------------------------
+// Defragmenter::DefragFile
+// 	If "file" is in more than one extent, and there is a free run big
+//	enough for all of its data, move it there, a chunk at a time.
+//	The run is looked for just after the file's header, as
+//	FileHeader::Allocate would.
+//
+//	The run is only a goal: it is not kept allocated between chunks,
+//	so if someone else takes part of it, the rest of the file goes to
+//	the next free run instead.
+//----------------------------------------------------------------------
+
+void
+Defragmenter::DefragFile(OpenFile *file)
+{
+    RWLock *fileLock = headerTable->FileLock(file->sector);
+    BitMap *freeMap;
+    int extents, numData, goal;
+    int next = 0, moved = 0, n;
+
+    fileLock->Acquire_r();
+    extents = CountExtents(file->hdr, &numData);
+    fileLock->Release_r();
+    if (extents <= 1)
+	return;
+
+    freeMap = fileSystem->AcquireFreeMap();
+    goal = freeMap->FindFullRun(file->sector + 1, numData);
+    for (int i = 0; goal != -1 && i < numData; i++)
+	freeMap->Clear(goal + i);	// only looking
+    fileSystem->ReleaseFreeMap();
+    if (goal == -1) {
+	DEBUG('D', "File at %d: %d extents, no run of %d sectors free\n",
+					file->sector, extents, numData);
+	return;
+    }
+
+    DEBUG('D', "File at %d: moving %d sectors in %d extents to %d\n",
+				file->sector, numData, extents, goal);
+    while ((n = MoveChunk(file, &next, &goal)) > 0)
+	moved += n;
+    numSectors += moved;
+    numFiles++;
+    stats->numDefragSectors += moved;
+}
+
+//----------------------------------------------------------------------
+// Defragmenter::MoveChunk
+// 	Move up to DefragChunk data sectors of "file", the first ones
+//	from file sector "*next" on that are not holes, to a free run
+//	starting at disk sector "*goal" if possible.  Advance "*next" and
+//	"*goal" past what was moved, and return how many sectors that
+//	was; 0 once the end of the file is reached, or the disk is full.
+//
+//	First we wait for the disk to be idle, so the chunk only runs
+//	when no one else is waiting for the disk.  Then, in one journal
+//	handle and with the file locked: allocate the new sectors, copy
+//	the data, point the header and index blocks at the copies, and
+//	free the old sectors.
+//----------------------------------------------------------------------
+
+int
+Defragmenter::MoveChunk(OpenFile *file, int *next, int *goal)
+{
+    RWLock *fileLock = headerTable->FileLock(file->sector);
+    FileHeader *hdr = file->hdr;
+    BitMap *freeMap;
+    int index[DefragChunk], from[DefragChunk], to[DefragChunk];
+    char data[DefragChunk * SectorSize];
+    int fileSectors, sector, start = -1, length = 0, n = 0, i;
+
+    synchDisk->WaitUntilIdle();
+    journal->Begin();
+    fileLock->Acquire_w();
+
+    fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    for (i = *next; i < fileSectors && n < DefragChunk; i++)
+	if ((sector = hdr->ByteToSector(i * SectorSize)) != 0) {
+	    index[n] = i;
+	    from[n++] = sector;
+	}
+    *next = i;
+
+    if (n > 0) {
+	freeMap = fileSystem->AcquireFreeMap();
+	start = freeMap->FindRun(*goal, n, &length);
+	fileSystem->ReleaseFreeMap();
+	if (length > 0 && length < n)
+	    *next = index[length];	// the rest go in the next chunk
+	n = length;
+    }
+    if (n > 0) {
+	for (i = 0; i < n; i++)
+	    to[i] = start + i;
+	synchDisk->ReadSectors(from, n, data);
+	synchDisk->WriteSectors(to, n, data);
+	for (i = 0; i < n; i++)
+	    hdr->MoveSector(index[i], to[i]);
+	hdr->WriteBack(file->sector);
+
+	for (i = 0; i < n; i++)
+	    journal->Free(from[i]);	// once the move is committed
+	*goal = start + n;
+	DEBUG('D', "File at %d: moved sectors %d.. to %d..%d\n",
+				file->sector, index[0], start, start + n - 1);
+    } else
+	n = 0;
+
+    fileLock->Release_w();
+    journal->End();
+    currentThread->Yield();		// let the foreground run
+    return n;
+}
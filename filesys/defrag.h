@@ -0,0 +1,53 @@
+// defrag.h
+//	Data structures for the online defragmenter, which moves the data
+//	sectors of each file into one run of consecutive sectors near its
+//	header, while the file system is in use.
+//
+//	Files that grow a little at a time end up in pieces all over the
+//	disk, so reading them sequentially seeks all the time.  The
+//	defragmenter runs as a kernel thread, making one pass over every
+//	directory and file from the root.  A file in more than one extent
+//	is moved, DefragChunk sectors at a time, into a free run big enough
+//	for all of it.
+//
+//	Each chunk is one metadata journal handle (cf. journal.h): the
+//	copies of the data, the new pointers in the header and index
+//	blocks, and the free map all commit together, so a crash leaves
+//	every sector either where it was or where it went, never lost.
+//	The file's lock is held for writing meanwhile, so nothing reads
+//	or writes it half moved.
+//
+//	The defragmenter stays out of the way of everyone else: before
+//	each chunk it waits until the disk has nothing else to do, and
+//	after it, it gives up the CPU.
+
+#ifndef DEFRAG_H
+#define DEFRAG_H
+
+#include "copyright.h"
+#include "openfile.h"
+
+#define DefragChunk	8		// data sectors moved per transaction
+
+// The following class defines the defragmenter.  It starts its thread
+// when it is created, and deletes itself when the pass is done.
+class Defragmenter {
+  public:
+    Defragmenter();			// start a pass over the file system
+
+    void Run();				// body of the defragmenting thread
+
+  private:
+    int numFiles;			// files moved so far
+    int numSectors;			// data sectors moved so far
+
+    void DefragDirectory(OpenFile *dir);// defragment everything in "dir"
+    void DefragFile(OpenFile *file);	// move "file" into one run, if it
+					// is in pieces and there is room
+    int MoveChunk(OpenFile *file, int *next, int *goal);
+					// move the next few data sectors of
+					// "file", from sector "next" of the
+					// file on, to disk sector "goal" on
+};
+
+#endif // DEFRAG_H
@@ -11,10 +11,14 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	When all the entries are in use, Add doubles the size of the
+//	table; the directory's file grows when it is written back.
+//
+//	Entries are found through an in-memory hash table on the name,
+//	rebuilt whenever the directory is fetched from disk.
+//
+//	The NameCache, at the end of this file, remembers the header
+//	sectors of recently used path names.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -25,8 +29,22 @@
 #include "filehdr.h"
 #include "directory.h"
 
-#define NumDirEntries 		10
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+//----------------------------------------------------------------------
+// HashName
+// 	Hash function for names in a directory, and for path names.
+//	Only the first "length" characters count.
+//----------------------------------------------------------------------
+
+static unsigned int
+HashName(char *name, int length)
+{
+    unsigned int h = 0;
+
+    for (int i = 0; i < length && name[i] != '\0'; i++)
+	h = h * 31 + (unsigned char) name[i];
+    return h;
+}
+
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
@@ -40,9 +58,11 @@
 Directory::Directory(int size)
 {
     table = new DirectoryEntry[size];
+    hashNext = new int[size];
     tableSize = size;
     for (int i = 0; i < tableSize; i++)
 	table[i].inUse = FALSE;
+    Rehash();
 }
 
 //----------------------------------------------------------------------
@@ -53,11 +73,57 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] hashNext;
 } 
 
+//----------------------------------------------------------------------
+// Directory::Resize
+// 	Change the number of entries in the directory to "size", keeping
+//	the entries that fit.  New entries are unused.
+//----------------------------------------------------------------------
+
+void
+Directory::Resize(int size)
+{
+    DirectoryEntry *newTable = new DirectoryEntry[size];
+
+    for (int i = 0; i < size; i++)
+	if (i < tableSize)
+	    newTable[i] = table[i];
+	else
+	    newTable[i].inUse = FALSE;
+    delete [] table;
+    delete [] hashNext;
+    table = newTable;
+    hashNext = new int[size];
+    tableSize = size;
+    Rehash();
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash
+// 	Rebuild the hash chains from the table of entries.
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash()
+{
+    int h;
+
+    for (int i = 0; i < DirHashSize; i++)
+	bucket[i] = -1;
+    for (int i = tableSize - 1; i >= 0; i--)
+	if (table[i].inUse) {
+	    h = HashName(table[i].name, FileNameMaxLen) % DirHashSize;
+	    hashNext[i] = bucket[h];
+	    bucket[h] = i;
+	}
+}
+
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk.  The directory has
+//	as many entries as fit in its file.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -65,7 +131,12 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
+    int size = file->Length() / sizeof(DirectoryEntry);
+
+    if (size != tableSize)
+	Resize(size);
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    Rehash();
 }
 
 //----------------------------------------------------------------------
@@ -92,7 +163,9 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
+    int h = HashName(name, FileNameMaxLen) % DirHashSize;
+
+    for (int i = bucket[h]; i != -1; i = hashNext[i])
         if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
     return -1;		// name not in directory
@@ -134,29 +207,6 @@ int Directory::getType(char* name){
     return -1;
 }
 
-int Directory::FindDir(char *name){
-    int sector = 1;
-    OpenFile *dir_file = new OpenFile(sector);
-    Directory *dir = new Directory(NumDirEntries);
-    dir->FetchFrom(dir_file);
-    int str_pos=0;
-    int sub_str_pos=0;
-    char sub_str[10];
-    while(str_pos<strlen(name)){
-        sub_str[sub_str_pos++]=name[str_pos++];
-        if(name[str_pos]=='/'){
-            sub_str[sub_str_pos]=0;
-            sector = dir->Find(sub_str);
-            dir_file = new OpenFile(sector);
-            dir = new Directory(NumDirEntries);
-            dir->FetchFrom(dir_file);
-            str_pos++;
-            sub_str_pos=0;
-        }
-    }
-    return sector;
-}
-
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
@@ -188,17 +238,20 @@ Directory::Add(char *name, int newSector,int type)
     file_name[j]=0;
     if(FindIndex(file_name)!=-1)
         return false;
-    for(int i=0;i<tableSize;++i){
-        if(!table[i].inUse){
-            table[i].inUse=true;
-            strncpy(table[i].path,name,20);
-            strncpy(table[i].name,file_name,FileNameMaxLen);
-            table[i].sector = newSector;
-            table[i].type = type;
-            return true;
-        }
-    }
-    return FALSE;	// no space.  Fix when we have extensible files.
+    int i;
+    for(i=0;i<tableSize && table[i].inUse;++i)
+        ;
+    if(i==tableSize)
+        Resize(2*tableSize);	// full: the file grows on WriteBack
+    int h = HashName(file_name, FileNameMaxLen) % DirHashSize;
+    table[i].inUse=true;
+    strncpy(table[i].path,name,20);
+    strncpy(table[i].name,file_name,FileNameMaxLen);
+    table[i].sector = newSector;
+    table[i].type = type;
+    hashNext[i] = bucket[h];
+    bucket[h] = i;
+    return true;
 }
 
 //----------------------------------------------------------------------
@@ -217,6 +270,7 @@ Directory::Remove(char *name)
     if (i == -1)
 	return FALSE; 		// name not in directory
     table[i].inUse = FALSE;
+    Rehash();
     return TRUE;	
 }
 
@@ -254,3 +308,132 @@ Directory::Print()
     printf("\n");
     delete hdr;
 }
+
+//----------------------------------------------------------------------
+// NameCache::NameCache
+// 	Initialize an empty cache of path names.
+//----------------------------------------------------------------------
+
+NameCache::NameCache()
+{
+    for (int i = 0; i < NameCacheSize; i++)
+	entries[i].path[0] = '\0';
+    for (int i = 0; i < NameCacheBuckets; i++)
+	buckets[i] = NULL;
+    hand = 0;
+    lock = new Lock("name cache");
+}
+
+//----------------------------------------------------------------------
+// NameCache::~NameCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+NameCache::~NameCache()
+{
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Open
+// 	If we remember where "path" is, open it and return the OpenFile;
+//	otherwise return NULL.
+//
+//	The file is opened before the cache is unlocked.  Remove forgets
+//	a path before it checks whether the file is open, so either it
+//	sees our open and gives up, or we do not find the path here.
+//----------------------------------------------------------------------
+
+OpenFile *
+NameCache::Open(char *path)
+{
+    NameCacheEntry *entry;
+    OpenFile *openFile = NULL;
+
+    if (strlen(path) > PathMaxLen)
+	return NULL;
+    lock->Acquire();
+    for (entry = buckets[HashName(path, PathMaxLen) % NameCacheBuckets];
+	 entry != NULL; entry = entry->next)
+	if (!strcmp(entry->path, path)) {
+	    openFile = new OpenFile(entry->sector);
+	    break;
+	}
+    lock->Release();
+    return openFile;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Enter
+// 	Remember that the header of "path" is at "sector", replacing an
+//	older entry if the cache is full.  Paths too long to store are
+//	just not cached.
+//----------------------------------------------------------------------
+
+void
+NameCache::Enter(char *path, int sector)
+{
+    int h;
+    NameCacheEntry *entry;
+
+    if (strlen(path) > PathMaxLen)
+	return;
+    lock->Acquire();
+    h = HashName(path, PathMaxLen) % NameCacheBuckets;
+    for (entry = buckets[h]; entry != NULL; entry = entry->next)
+	if (!strcmp(entry->path, path))
+	    break;
+    if (entry == NULL) {
+	entry = &entries[hand];
+	hand = (hand + 1) % NameCacheSize;
+	if (entry->path[0] != '\0')
+	    Unhash(entry);
+	strcpy(entry->path, path);
+	entry->next = buckets[h];
+	buckets[h] = entry;
+    }
+    entry->sector = sector;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// NameCache::Invalidate
+// 	Forget "path", and every path that goes through it (the file is
+//	being removed, and if it is a directory, so is everything in it).
+//	"" is the root directory: forget everything.
+//----------------------------------------------------------------------
+
+void
+NameCache::Invalidate(char *path)
+{
+    int length = strlen(path);
+    NameCacheEntry *entry;
+
+    lock->Acquire();
+    for (int i = 0; i < NameCacheSize; i++) {
+	entry = &entries[i];
+	if (entry->path[0] != '\0' && !strncmp(entry->path, path, length)
+		&& (length == 0 || entry->path[length] == '\0'
+				|| entry->path[length] == '/')) {
+	    Unhash(entry);
+	    entry->path[0] = '\0';
+	}
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// NameCache::Unhash
+// 	Take "entry" out of its hash bucket.
+//----------------------------------------------------------------------
+
+void
+NameCache::Unhash(NameCacheEntry *entry)
+{
+    NameCacheEntry **link = &buckets[HashName(entry->path, PathMaxLen)
+				     % NameCacheBuckets];
+
+    while (*link != entry)
+	link = &(*link)->next;
+    *link = entry->next;
+}
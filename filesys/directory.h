@@ -8,6 +8,10 @@
 //
 //      We assume mutual exclusion is provided by the caller.
 //
+//	Also defines the NameCache, which remembers where the headers
+//	of recently used path names are, so that most path lookups do
+//	not have to read directories at all.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -18,9 +22,14 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "synch.h"
 
 #define FileNameMaxLen 		9	// for simplicity, we assume 
 					// file names are <= 9 characters long
+#define DirHashSize		31	// buckets in a directory's index
+#define PathMaxLen		63	// longer paths are not cached
+#define NameCacheSize		64	// paths the NameCache remembers
+#define NameCacheBuckets	31
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -45,6 +54,10 @@ class DirectoryEntry {
 //
 // The directory data structure can be stored in memory, or on disk.
 // When it is on disk, it is stored as a regular Nachos file.
+// The file grows when an entry is added to a full directory.
+//
+// In memory, the entries are also chained into a hash table on their
+// names, so that Find does not have to look at every entry.
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
@@ -56,15 +69,17 @@ class Directory {
 					// with space for "size" files
     ~Directory();			// De-allocate the directory
 
-    void FetchFrom(OpenFile *file);  	// Init directory contents from disk
+    void FetchFrom(OpenFile *file);  	// Init directory contents from disk;
+					// the table takes the size of the
+					// file
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
-    int FindDir(char *name);
 
-    bool Add(char *name, int newSector,int type);  // Add a file name into the directory
+    bool Add(char *name, int newSector,int type);  // Add a file name into the directory,
+					// making the table bigger if needed
 
     bool Remove(char *name);		// Remove a file from the directory
 
@@ -80,9 +95,50 @@ class Directory {
     int tableSize;			// Number of directory entries
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
+    int bucket[DirHashSize];		// first entry with each hash value,
+					// -1 if none
+    int *hashNext;			// next entry in the same bucket
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    void Resize(int size);		// change the number of entries
+    void Rehash();			// rebuild bucket and hashNext
+};
+
+// One path remembered by the NameCache.
+class NameCacheEntry {
+  public:
+    char path[PathMaxLen + 1];		// full path name, "" if unused
+    int sector;				// where its header is
+    NameCacheEntry *next;		// next entry in the same bucket
+};
+
+// The following class maps full path names ("a/b/c") to the sector of
+// their file header.  FileSystem looks every prefix of a path up here
+// before reading any directory, and adds what it had to read.  Create
+// and Remove keep it up to date.
+//
+// Entries are replaced round robin once the cache is full.
+
+class NameCache {
+  public:
+    NameCache();			// an empty cache
+    ~NameCache();
+
+    OpenFile *Open(char *path);		// open "path" if it is cached, so
+					// that it cannot be removed in
+					// between; NULL if not
+    void Enter(char *path, int sector);	// remember where "path" is
+    void Invalidate(char *path);	// forget "path" and every path
+					// below it
+
+  private:
+    NameCacheEntry entries[NameCacheSize];
+    NameCacheEntry *buckets[NameCacheBuckets];
+    int hand;				// next entry to replace
+    Lock *lock;				// protects all of the above
+
+    void Unhash(NameCacheEntry *entry);	// take entry out of its bucket
 };
 
 #endif // DIRECTORY_H
@@ -5,9 +5,9 @@
 //	The file header is used to locate where on disk the 
 //	file's data is stored.  We implement this as a fixed size
 //	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
+//	disk sector containing that portion of the file data -- followed
+//	by the roots of single, double and triple indirect trees of index
+//	blocks (cf. filehdr.h).  The table size is chosen so that the file header
 //	will be just big enough to fit in one disk sector, 
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
@@ -27,6 +27,102 @@
 #include "system.h"
 #include "filehdr.h"
 
+//----------------------------------------------------------------------
+// Span
+// 	Return how many data sectors an index tree "depth" levels deep
+//	can list: PointersPerSector^depth.
+//----------------------------------------------------------------------
+
+static int
+Span(int depth)
+{
+    int span = 1;
+
+    while (depth-- > 0)
+	span *= PointersPerSector;
+    return span;
+}
+
+//----------------------------------------------------------------------
+// NumIndexBlocks
+// 	Return how many index blocks a file of "numSectors" data sectors
+//	needs, besides the header.  A tree "depth" levels deep that lists
+//	m sectors has ceil(m / PointersPerSector^k) blocks on each level k.
+//----------------------------------------------------------------------
+
+static int
+NumIndexBlocks(int numSectors)
+{
+    int left = numSectors - NumDirect;
+    int blocks = 0;
+
+    for (int depth = 1; depth <= NumIndirect && left > 0; depth++) {
+	int listed = min(left, Span(depth));
+
+	for (int k = 1; k <= depth; k++)
+	    blocks += divRoundUp(listed, Span(k));
+	left -= listed;
+    }
+    return blocks;
+}
+
+//----------------------------------------------------------------------
+// FreeIndexTree
+// 	Give back the sectors of an index tree "depth" levels deep rooted
+//	at "sector" -- its index blocks and the data sectors they list --
+//	once the running transaction commits (cf. Journal::Free).
+//	A depth of 0 is just a data sector.
+//----------------------------------------------------------------------
+
+static void
+FreeIndexTree(int sector, int depth)
+{
+    int table[PointersPerSector];
+
+    if (sector == 0)
+	return;				// nothing there
+    if (depth > 0) {
+	synchDisk->ReadSector(sector, (char *) table);
+	for (int i = 0; i < PointersPerSector; i++)
+	    FreeIndexTree(table[i], depth - 1);
+    }
+    journal->Free(sector);
+}
+
+//----------------------------------------------------------------------
+// NewIndexBlock
+// 	Allocate a sector for an index block, as close after "near" as
+//	possible, and fill it with "no sector" entries.  Return the sector.
+//----------------------------------------------------------------------
+
+static int
+NewIndexBlock(BitMap *freeMap, int near)
+{
+    int table[PointersPerSector];
+    int length;
+    int sector = freeMap->FindRun(near, 1, &length);
+
+    ASSERT(sector >= 0);
+    bzero((char *) table, sizeof(table));
+    synchDisk->WriteSector(sector, (char *) table);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// UpdateIndex
+// 	Set entry "i" of the index block at "sector" to "value".
+//----------------------------------------------------------------------
+
+static void
+UpdateIndex(int sector, int i, int value)
+{
+    int table[PointersPerSector];
+
+    synchDisk->ReadSector(sector, (char *) table);
+    table[i] = value;
+    synchDisk->WriteSector(sector, (char *) table);
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -36,95 +132,244 @@
 //
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
+//	"hdrSector" is where this header is stored; the data is put
+//	right after it if there is room
 //----------------------------------------------------------------------
 
 bool
-FileHeader::Allocate(BitMap *freeMap, int fileSize)
+FileHeader::Allocate(BitMap *freeMap, int fileSize, int hdrSector)
 { 
-    numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
+    numBytes = 0;
+    numSectors = 0;
+    for (int i = 0; i < NumDirect; i++)
+	dataSectors[i] = 0;
+    for (int d = 0; d < NumIndirect; d++)
+	indirect[d] = 0;
+    return Extend(freeMap, fileSize, hdrSector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Grow the file by "bytes" bytes, allocating data sectors (and index
+//	blocks) for it out of the map of free disk blocks.  Return FALSE,
+//	leaving the file as it was, if there is not enough space.
+//
+//	The new sectors are taken in runs of consecutive free sectors,
+//	continuing from the file's last sector (or, for an empty file,
+//	from its header), so that the file stays on as few tracks as
+//	possible and reading it through does not seek.  An index block
+//	that is needed along the way goes right after the run it indexes.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"bytes" is how much longer the file gets
+//	"hdrSector" is where this header is stored
+//
+//	The file must have no holes, as when it is made by Allocate.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Extend(BitMap *freeMap, int bytes, int hdrSector)
+{
+    int newBytes = numBytes + bytes;
+    int newSectors = divRoundUp(newBytes, SectorSize);
+    int needed = (newSectors - numSectors)
+		 + NumIndexBlocks(newSectors) - NumIndexBlocks(numSectors);
+    int goal, start, length;
+
+    if (newSectors > MaxFileSectors || freeMap->NumClear() < needed)
 	return FALSE;		// not enough space
+    DEBUG('f', "Extending file by %d sectors\n", newSectors - numSectors);
 
-    if(numSectors<NumDirect){
-        for (int i = 0; i < numSectors; i++)
-	        dataSectors[i] = freeMap->Find();
-        return TRUE;
-    }else{
-        for(int i=0;i<NumDirect-1;++i){
-            dataSectors[i] = freeMap->Find();
-        }
-        dataSectors[NumDirect-1] = freeMap->Find();
-        int left = numSectors - (NumDirect-1);
-        int indirect_index[32]; 
-        int pos=0;
-        int index_sector = dataSectors[NumDirect-1];
-        while(left>0){
-            if(pos==31&&left>0){
-                int temp=freeMap->Find();
-                indirect_index[31]=temp;
-                synchDisk->WriteSector(index_sector,(char*)indirect_index);
-                index_sector=temp;
-                pos=0;
-                continue;
-            }
-            indirect_index[pos]=freeMap->Find();
-            pos++;
-            left--;
-        }
-        synchDisk->WriteSector(index_sector,(char*)indirect_index);
-        //for(int i=0;i<numSectors-(NumDirect-1);++i){
-        //    indirect_index[i]=freeMap->Find();
-        //    if(indirect_index[i]==-1){
-        //        printf("no memory\n");
-        //        ASSERT(indirect_index!=-1);
-        //    }
-        //}
-        //synchDisk->WriteSector(dataSectors[NumDirect-1],(char *)indirect_index);
-        return TRUE;
+    goal = (numSectors > 0) ? SectorOf(numSectors - 1) + 1 : hdrSector + 1;
+    for (int i = numSectors; i < newSectors; i += length) {
+	start = freeMap->FindRun(goal, newSectors - i, &length);
+	ASSERT(start >= 0);
+	DEBUG('f', "Sectors %d to %d of the file at %d to %d\n", i,
+	      i + length - 1, start, start + length - 1);
+	for (int j = 0; j < length; j++)
+	    SetSector(freeMap, i + j, start + j);
+	goal = start + length;
     }
+    numSectors = newSectors;
+    numBytes = newBytes;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
-// FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// FileHeader::SetLength
+// 	Make the file "fileSize" bytes long, without allocating anything:
+//	the part past the old end is a hole.  Return FALSE if the file
+//	cannot be that big.  Files never shrink.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::SetLength(int fileSize)
+{
+    if (fileSize > MaxFileSize)
+	return FALSE;
+    if (fileSize > numBytes) {
+	numBytes = fileSize;
+	numSectors = divRoundUp(fileSize, SectorSize);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::HasHoles
+// 	Return TRUE if any of the file's data sectors "first" through
+//	"last" has no disk sector yet.  They may lie past the end of the
+//	file, but not past MaxFileSectors.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::HasHoles(int first, int last)
+{
+    for (int i = first; i <= last; i++)
+	if (SectorOf(i) == 0)
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateRange
+// 	Give each hole among the file's data sectors "first" through
+//	"last" a disk sector, so that they can be written.  As in Extend,
+//	the sectors are taken in runs, each continuing from the sector
+//	before it in the file when that is free.
+//
+//	Return how many of the sectors, counting from "first", now have a
+//	disk sector: all of them, unless the disk filled up.  Enough free
+//	sectors are always kept back for the index blocks a run may need.
 //
 //	"freeMap" is the bit map of free disk sectors
+//	"hdrSector" is where this header is stored
 //----------------------------------------------------------------------
 
-void 
-FileHeader::Deallocate(BitMap *freeMap)
+int
+FileHeader::AllocateRange(BitMap *freeMap, int first, int last,
+			  int hdrSector)
 {
-    if(numSectors<NumDirect){
-        for (int i = 0; i < numSectors; i++) {
-	        ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	        freeMap->Clear((int) dataSectors[i]);
-        }
-    }else{
-        int left = numSectors-(NumDirect-1)-1;
-        int rank = left/31;
-        int sector[rank+1];
-        char *indirect_index = new char[SectorSize];
-        sector[0]=dataSectors[NumDirect-1];
-        synchDisk->ReadSector(dataSectors[NumDirect-1],indirect_index);
-        for(int i=1;i<=rank;++i){
-            sector[i]=int(indirect_index[31*4]);
-            synchDisk->ReadSector(sector[i],indirect_index);
-        }
-        int temp=left%31;
-        for(int i=0;i<=temp;++i){
-            freeMap->Clear((int) indirect_index[i*4]);
-        }
-        for(int i=rank-1;i>=0;--i){
-            synchDisk->ReadSector(sector[i],indirect_index);
-            for(int j=0;j<32;++j){
-                freeMap->Clear((int) indirect_index[j*4]);
-            }
-        }
-        for(int i=0;i<NumDirect;++i){
-            freeMap->Clear((int) dataSectors[i]);
-        }
+    int i = first, j, want, reserve, start, length;
+    int goal = (first > 0) ? SectorOf(first - 1) : 0;
+
+    goal = (goal != 0) ? goal + 1 : hdrSector + 1;
+    while (i <= last) {
+	int sector = SectorOf(i);
+
+	if (sector != 0) {		// already there
+	    goal = sector + 1;
+	    i++;
+	    continue;
+	}
+	for (j = i + 1; j <= last && SectorOf(j) == 0; j++)
+	    ;
+	want = j - i;			// holes i to j - 1
+	reserve = NumIndirect + 2 * divRoundUp(want, PointersPerSector);
+	want = min(want, freeMap->NumClear() - reserve);
+	if (want <= 0)
+	    break;			// disk full
+	start = freeMap->FindRun(goal, want, &length);
+	DEBUG('f', "Filling sectors %d to %d of the file at %d to %d\n", i,
+	      i + length - 1, start, start + length - 1);
+	for (int k = 0; k < length; k++)
+	    SetSector(freeMap, i + k, start + k);
+	i += length;
+	goal = start + length;
     }
+    return i - first;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IndexRoot
+// 	Return where the "index"th data sector of the file is listed: in
+//	the header itself ("depth" set to 0), or else in the tree "depth"
+//	levels deep whose root is returned.  "index" is changed to the
+//	number of the sector within that tree.
+//----------------------------------------------------------------------
+
+int *
+FileHeader::IndexRoot(int *index, int *depth)
+{
+    if (*index < NumDirect) {
+	*depth = 0;
+	return &dataSectors[*index];
+    }
+    *index -= NumDirect;
+    for (int d = 1; d <= NumIndirect; d++) {
+	if (*index < Span(d)) {
+	    *depth = d;
+	    return &indirect[d - 1];
+	}
+	*index -= Span(d);
+    }
+    ASSERT(FALSE);			// past MaxFileSectors
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetSector
+// 	Record that the "index"th data sector of the file is "sector".
+//	Index blocks are allocated the first time they are needed, near
+//	the data they list.
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetSector(BitMap *freeMap, int index, int sector)
+{
+    int table[PointersPerSector];
+    int depth, block, slot;
+    int *root = IndexRoot(&index, &depth);
+
+    if (depth == 0) {
+	*root = sector;
+	return;
+    }
+    if (*root == 0)
+	*root = NewIndexBlock(freeMap, sector);
+    block = *root;
+    for (int d = depth - 1; d > 0; d--) {	// down to the last level
+	slot = (index / Span(d)) % PointersPerSector;
+	synchDisk->ReadSector(block, (char *) table);
+	if (table[slot] == 0) {
+	    table[slot] = NewIndexBlock(freeMap, sector);
+	    UpdateIndex(block, slot, table[slot]);
+	}
+	block = table[slot];
+    }
+    UpdateIndex(block, index % PointersPerSector, sector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MoveSector
+// 	Record that the "index"th data sector of the file now lives at
+//	"sector" (cf. Defragmenter).  It is not a hole, so the index blocks
+//	on the way to it exist already, and nothing is allocated.  The
+//	old sector is the caller's to free.
+//----------------------------------------------------------------------
+
+void
+FileHeader::MoveSector(int index, int sector)
+{
+    ASSERT(SectorOf(index) != 0);
+    SetSector(NULL, index, sector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Deallocate
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and the index blocks that list them.  They stay marked in the
+//	free map until the running transaction commits, so that nothing
+//	can overwrite them while a crash could still bring the file back.
+//	Must be called inside a journal handle.
+//----------------------------------------------------------------------
+
+void 
+FileHeader::Deallocate()
+{
+    for (int i = 0; i < NumDirect; i++)
+	FreeIndexTree(dataSectors[i], 0);
+    for (int d = 1; d <= NumIndirect; d++)
+	FreeIndexTree(indirect[d - 1], d);
 }
 
 //----------------------------------------------------------------------
@@ -166,22 +411,28 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    if(offset<((NumDirect-1)*SectorSize)){
-        return(dataSectors[offset / SectorSize]);
-    }else{
-        int sector_position = (offset-(NumDirect-1)*SectorSize)/SectorSize;
-        int rank = (sector_position)/31;
-        sector_position = sector_position%31;
-        int sector=dataSectors[NumDirect-1];
-        char *indirect_index = new char[SectorSize];
-        while(rank>0){
-            synchDisk->ReadSector(sector,indirect_index);
-            sector = int(indirect_index[31*4]);
-            rank--;
-        }
-        synchDisk->ReadSector(sector,indirect_index);
-        return int(indirect_index[sector_position*4]);
+    return SectorOf(offset / SectorSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SectorOf
+// 	Return the disk sector holding the "index"th data sector of the
+//	file: straight from the header, or down through one, two or three
+//	index blocks.
+//----------------------------------------------------------------------
+
+int
+FileHeader::SectorOf(int index)
+{
+    int table[PointersPerSector];
+    int depth;
+    int sector = *IndexRoot(&index, &depth);
+
+    for (int d = depth - 1; d >= 0 && sector != 0; d--) {
+	synchDisk->ReadSector(sector, (char *) table);
+	sector = table[(index / Span(d)) % PointersPerSector];
     }
+    return sector;
 }
 
 //----------------------------------------------------------------------
@@ -210,45 +461,20 @@ FileHeader::Print()
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
     printf("create_time: %s\n",create_time);
     for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+	printf("%d ", SectorOf(i));		// 0 for a hole
     printf("\nFile contents:\n");
-    printf("%d %d\n",numSectors,NumDirect);
-    if(numSectors<NumDirect){
-        for (i = k = 0; i < numSectors; i++) {
-            synchDisk->ReadSector(dataSectors[i], data);
-            for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
-                if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-                    printf("%c", data[j]);
-                else
-                    printf("\\%x", (unsigned char)data[j]);
-            }
-            printf("\n"); 
-        }
-    }else{
-        for(i=k=0;i<NumDirect-1;++i){
-            printf("sector: %d\n",dataSectors[i]);
-            synchDisk->ReadSector(dataSectors[i],data);
-            for(j=0;(j<SectorSize)&&(k<numBytes);++j,++k){
-                if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-                    printf("%c", data[j]);
-                else
-                    printf("\\%x", (unsigned char)data[j]);
-            }
-            printf("\n");
-        }
-        char *indirect_index = new char[SectorSize];
-        synchDisk->ReadSector(dataSectors[NumDirect-1],indirect_index);
-        for(int i=0;i<numSectors-(NumDirect-1);++i){
-            printf("Sector: %d\n",int(indirect_index[i*4]));
-            synchDisk->ReadSector(int(indirect_index[i*4]),data);
-            for(j=0;(j<SectorSize)&&(k<numBytes);++j,++k){
-                if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
-                    printf("%c", data[j]);
-                else
-                    printf("\\%x", (unsigned char)data[j]);
-            }
-            printf("\n");
-        }
+    for (i = k = 0; i < numSectors; i++) {
+	if (SectorOf(i) == 0)
+	    bzero(data, SectorSize);
+	else
+	    synchDisk->ReadSector(SectorOf(i), data);
+	for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
+	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
+		printf("%c", data[j]);
+	    else
+		printf("\\%x", (unsigned char)data[j]);
+	}
+	printf("\n"); 
     }
     delete [] data;
 }
@@ -262,71 +488,197 @@ void FileHeader::set_create_time(){
 
 }
 
-void FileHeader::Extend(BitMap* freeMap,int bytes){
-    numBytes = numBytes+bytes;
-    int initial_sector = numSectors;
-    numSectors = divRoundUp(numBytes,SectorSize);
-    if(initial_sector == numSectors)
-        return true;
-    if(freeMap->NumClear()<numSectors - initial_sector)
-        return false;
-    printf("extend %d sectors\n",numSectors - initial_sector);
-
-    if(initial_sector<NumDirect){
-        if(numSectors<NumDirect){
-            for(int i=initial_sector;i<numSectors;++i)
-                dataSectors[i]=freeMap->Find();
-        }else{
-            for(int i=initial_sector;i<NumDirect-1;++i){
-                dataSectors[i] = freeMap->Find();
-            }
-            dataSectors[NumDirect-1] = freeMap->Find();
-            int left = numSectors - (NumDirect-1);
-            int indirect_index[32]; 
-            int pos=0;
-            int index_sector = dataSectors[NumDirect-1];
-            while(left>0){
-                if(pos==31&&left>0){
-                    int temp=freeMap->Find();
-                    indirect_index[31]=temp;
-                    synchDisk->WriteSector(index_sector,(char*)indirect_index);
-                    index_sector=temp;
-                    pos=0;
-                    continue;
-                }
-                indirect_index[pos]=freeMap->Find();
-                pos++;
-                left--;
-            }
-            synchDisk->WriteSector(index_sector,(char*)indirect_index);
-
-        }
-    }else{
-        int init_sec = initial_sector-NumDirect+1;//从这里出发
-        int rank = init_sec /31;
-        int pos = init_sec % 31;
-        int sector = dataSectors[NumDirect-1];
-        int indirect_index[32]; 
-        for(int i=0;i<=rank;++i){
-            synchDisk->ReadSector(sector,(char*)indirect_index);
-            if(i!=rank){
-                sector = indirect_index[31];
-            }
-        }
-        int left = numSectors - initial_sector;
-        while(left>0){
-            indirect_index[pos]=freeMap->Find();
-            pos++;
-            left--;
-            if(pos == 31){
-                int temp=freeMap->Find();
-                indirect_index[31]=temp;
-                synchDisk->WriteSector(sector,(char*)indirect_index);
-                sector=temp;
-                pos=0;
-            }
-        }
-        synchDisk->WriteSector(sector,(char*)indirect_index);
+// One header in the HeaderTable.
+class HeaderTableEntry {
+  public:
+    int sector;				// where the header lives on disk
+    int refCount;			// OpenFiles using it
+    FileHeader *hdr;			// the shared copy
+    bool loading;			// hdr is still being read from disk
+    RWLock *fileLock;			// on the file's contents
+    RWLock *dirLock;			// on its names, if a directory
+    HeaderTableEntry *next;		// next entry in the same bucket
+};
+
+//----------------------------------------------------------------------
+// HeaderTable::HeaderTable
+// 	Initialize an empty table of open file headers.
+//----------------------------------------------------------------------
+
+HeaderTable::HeaderTable()
+{
+    for (int i = 0; i < HeaderTableBuckets; i++)
+	buckets[i] = NULL;
+    lock = new Lock("header table lock");
+    loaded = new Condition("header loaded");
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::~HeaderTable
+// 	De-allocate the table, and any headers still open.
+//----------------------------------------------------------------------
+
+HeaderTable::~HeaderTable()
+{
+    for (int i = 0; i < HeaderTableBuckets; i++)
+	while (buckets[i] != NULL) {
+	    HeaderTableEntry *entry = buckets[i];
+
+	    buckets[i] = entry->next;
+	    delete entry->hdr;
+	    delete entry->fileLock;
+	    delete entry->dirLock;
+	    delete entry;
+	}
+    delete loaded;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::Find
+// 	Return the entry for the header at "sector", or NULL if that file
+//	is not open.  The caller must hold the lock.
+//----------------------------------------------------------------------
+
+HeaderTableEntry *
+HeaderTable::Find(int sector)
+{
+    HeaderTableEntry *entry;
+
+    for (entry = buckets[sector % HeaderTableBuckets]; entry != NULL;
+							entry = entry->next)
+	if (entry->sector == sector)
+	    return entry;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::Open
+// 	Return the in-core header for the file whose header is stored at
+//	"sector", and count one more reference to it.  If the file is not
+//	open yet, read the header from disk.
+//
+//	The table is not locked while the header is read, so that opens of
+//	other files don't wait for the disk; the entry is marked "loading"
+//	meanwhile, and anyone else opening the same file waits for it.
+//
+//	"sector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+FileHeader *
+HeaderTable::Open(int sector)
+{
+    HeaderTableEntry *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    if (entry == NULL) {
+	entry = new HeaderTableEntry;
+	entry->sector = sector;
+	entry->refCount = 1;
+	entry->hdr = new FileHeader;
+	entry->loading = TRUE;
+	entry->fileLock = new RWLock("file lock");
+	entry->dirLock = new RWLock("directory lock");
+	entry->next = buckets[sector % HeaderTableBuckets];
+	buckets[sector % HeaderTableBuckets] = entry;
+	lock->Release();
+
+	entry->hdr->FetchFrom(sector);	// may wait for the disk
+
+	lock->Acquire();
+	entry->loading = FALSE;
+	loaded->Broadcast(lock);
+    } else {
+	entry->refCount++;		// so it stays while we wait
+	while (entry->loading)
+	    loaded->Wait(lock);
+    }
+    lock->Release();
+    return entry->hdr;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::Close
+// 	Drop a reference to the header at "sector"; when the last one
+//	goes, so does the in-core copy.  Any change to it has already been
+//	written back.
+//----------------------------------------------------------------------
+
+void
+HeaderTable::Close(int sector)
+{
+    HeaderTableEntry **link;
+    HeaderTableEntry *entry;
+
+    lock->Acquire();
+    for (link = &buckets[sector % HeaderTableBuckets]; *link != NULL;
+						link = &(*link)->next)
+	if ((*link)->sector == sector)
+	    break;
+    entry = *link;
+    ASSERT(entry != NULL && entry->refCount > 0);
+    if (--entry->refCount == 0) {
+	*link = entry->next;
+	delete entry->hdr;
+	delete entry->fileLock;
+	delete entry->dirLock;
+	delete entry;
     }
-    return true;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::NumOpens
+// 	Return how many OpenFiles currently share the header at "sector".
+//----------------------------------------------------------------------
+
+int
+HeaderTable::NumOpens(int sector)
+{
+    HeaderTableEntry *entry;
+    int count;
+
+    lock->Acquire();
+    entry = Find(sector);
+    count = (entry == NULL) ? 0 : entry->refCount;
+    lock->Release();
+    return count;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::FileLock
+// 	Return the reader/writer lock on the contents of the open file
+//	whose header is at "sector".  It lasts as long as the file is open.
+//----------------------------------------------------------------------
+
+RWLock *
+HeaderTable::FileLock(int sector)
+{
+    HeaderTableEntry *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    ASSERT(entry != NULL);
+    lock->Release();
+    return entry->fileLock;
+}
+
+//----------------------------------------------------------------------
+// HeaderTable::DirLock
+// 	Return the reader/writer lock on the names in the open directory
+//	whose header is at "sector".  Like FileLock, the caller must keep
+//	the directory open while using it.
+//----------------------------------------------------------------------
+
+RWLock *
+HeaderTable::DirLock(int sector)
+{
+    HeaderTableEntry *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    ASSERT(entry != NULL);
+    lock->Release();
+    return entry->dirLock;
 }
@@ -16,33 +16,63 @@
 
 #include "disk.h"
 #include "bitmap.h"
+#include "synch.h"
 #include <time.h>
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)-25) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+#define NumPointers 	((SectorSize - 2 * sizeof(int)-25) / sizeof(int))
+					// sector numbers that fit in the
+					// header, after the other fields
+#define NumIndirect	3		// single, double and triple
+#define NumDirect 	(NumPointers - NumIndirect)
+#define PointersPerSector (SectorSize / sizeof(int))
+					// entries in an index block
+#define MaxFileSectors	(NumDirect + PointersPerSector \
+			 + PointersPerSector * PointersPerSector \
+			 + PointersPerSector * PointersPerSector \
+			   * PointersPerSector)
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of pointers to data blocks,
+// as in UNIX: the first NumDirect data sectors are listed in the header
+// itself; the next PointersPerSector are listed in a single indirect
+// block; the next PointersPerSector^2 in index blocks that are listed
+// in a doubly indirect block; and the rest in a triply indirect tree
+// the same way.  Finding any sector of a file therefore takes at most
+// three index block reads, and those normally hit in the buffer cache.
+// An index entry of 0 means "no sector" (sector 0 is the free map's
+// header, so it is never part of a file).
+//
+// Files may be sparse: a data sector that was never written need not
+// have a disk sector (a "hole"; its entry is 0).  It reads as zeros,
+// and gets a sector the first time something is written into it.
+// Files made by FileSystem::Create start out as one big hole.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.
+//
+// The triple indirect root took one of the direct pointers, so headers
+// written before it was added are misread: such disks must be
+// reformatted (-f).
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
 
 class FileHeader {
+  friend class FileSystemChecker;	// reads the raw pointers
   public:
-    bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
+    bool Allocate(BitMap *bitMap, int fileSize, int hdrSector);
+						// Initialize a file header, 
 						//  including allocating space 
-						//  on disk for the file data
-    void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
-						//  data blocks
+						//  on disk for the file data,
+						//  near its header "hdrSector"
+    void Deallocate();  			// De-allocate this file's 
+						//  data blocks, once the
+						//  running transaction commits
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -57,14 +87,87 @@ class FileHeader {
 
     void Print();			// Print the contents of the file.
     void set_create_time();
-    void Extend(BitMap* freeMap,int bytes);
+    bool Extend(BitMap* freeMap,int bytes,int hdrSector);
+						// Grow the file by "bytes",
+						//  allocating runs of sectors
+						//  after its last one; FALSE
+						//  if the disk is too full
+    bool SetLength(int fileSize);		// Grow the file to "fileSize"
+						//  bytes, leaving the new part
+						//  a hole
+    bool HasHoles(int first, int last);	// Is any of data sectors first
+					// to last a hole?
+    int AllocateRange(BitMap *freeMap, int first, int last, int hdrSector);
+					// Fill the holes among data sectors
+					// first to last; return how many
+					// from "first" on have a sector
+    void MoveSector(int index, int sector);
+					// Record that data sector "index",
+					// not a hole, has been copied to
+					// "sector"
 
     int numBytes;			// Number of bytes in the file
   private:
     char create_time[25];
-    int numSectors;			// Number of data sectors in the file
+    int numSectors;			// Number of data sectors the file
+					// spans, holes included
     int dataSectors[NumDirect];		// Disk sector numbers for each data 
 					// block in the file
+    int indirect[NumIndirect];		// roots of the index trees:
+					// indirect[d - 1] indexes the next
+					// PointersPerSector^d data sectors
+					// through d levels of index blocks
+
+    int *IndexRoot(int *index, int *depth);
+					// where the index'th data sector is
+					// listed, or the root of its tree
+    int SectorOf(int index);		// disk sector of the index'th data
+					// sector of the file
+    void SetSector(BitMap *freeMap, int index, int sector);
+					// make it "sector", allocating index
+					// blocks on the way if needed
+};
+
+// The following class keeps the one in-core copy of the header of each
+// open file.  All the OpenFiles for a file share it, so a change made
+// through one of them (such as extending the file) is seen by all the
+// others.  Entries are found by header sector and reference counted;
+// the entry goes away when the last OpenFile for the file is closed.
+//
+// Changes to a shared header are written with FileHeader::WriteBack as
+// before; that only updates the buffer cache, which writes the sector
+// to disk later.
+//
+// Each entry also carries the file's locks (cf. the locking order in
+// filesys.cc): a reader/writer lock on its contents, taken by
+// OpenFile::ReadAt and WriteAt, and, if the file is a directory, a
+// reader/writer lock on the names in it, taken by FileSystem.
+
+class HeaderTableEntry;
+
+#define HeaderTableBuckets	31	// hash buckets, by header sector
+
+class HeaderTable {
+  public:
+    HeaderTable();
+    ~HeaderTable();
+
+    FileHeader *Open(int sector);	// return the shared header stored
+					// at "sector", reading it from disk
+					// only if no one has it open
+    void Close(int sector);		// drop one reference
+    int NumOpens(int sector);		// number of references
+    RWLock *FileLock(int sector);	// locks of an open header: on the
+    RWLock *DirLock(int sector);	// file's data, and on the names in
+					// it if it is a directory
+
+  private:
+    HeaderTableEntry *buckets[HeaderTableBuckets];
+    Lock *lock;				// protects the buckets and counts
+    Condition *loaded;			// signalled when a header has been
+					// read in from disk
+
+    HeaderTableEntry *Find(int sector);	// entry for sector, or NULL
 };
 
 #endif // FILEHDR_H
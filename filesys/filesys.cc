@@ -7,11 +7,13 @@
 //		(the size of the file header data structure is arranged
 //		to be precisely the size of 1 disk sector)
 //	   A number of data blocks
-//	   An entry in the file system directory
+//	   An entry in a directory
 //
 // 	The file system consists of several data structures:
 //	   A bitmap of free disk sectors (cf. bitmap.h)
-//	   A directory of file names and file headers
+//	   A tree of directories of file names and file headers, whose
+//	     root is found at a fixed sector; a file is named by its path
+//	     from there ("a/b/c")
 //
 //      Both the bitmap and the directory are represented as normal
 //	files.  Their file headers are located in specific sectors
@@ -21,23 +23,47 @@
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
+//	The bitmap is also kept in memory all the time, behind a lock
+//	(cf. AcquireFreeMap); only the sectors of it that an operation
+//	changed are written back to disk.
+//
+//	Concurrent operations are kept apart by locks, always taken in
+//	this order, so that no two threads can wait for each other:
+//
+//	   a journal handle (cf. journal.h), if the operation changes
+//	     metadata
+//	   directory locks, a directory's before those of the directories
+//	     in it: held shared while looking a name up, exclusive while
+//	     adding or removing one
+//	   file locks, on the contents of one file (cf. OpenFile::ReadAt)
+//	   the free map lock (cf. AcquireFreeMap)
+//	   locks internal to one module, such as the name cache's, the
+//	     header table's and the buffer cache's
+//
+//	The directory and file locks of a file live in its entry in the
+//	header table, so they exist while the file is open.  The one
+//	exception to the order is the free map file itself: it is
+//	written while the free map lock is held, but no one takes the
+//	free map lock while holding its file lock.
+//
+//	So operations on different files, or on different directories,
+//	run in parallel, until they need the free map.
+//
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written back (the two files are kept open during all this
+//	time).  They are written through the metadata journal (cf.
+//	journal.h), so that a crash cannot leave them half done.  If the
+//	operation fails, and we have modified part of the directory, we
+//	simply discard the changed version, without writing it back to
+//	disk; changes to the bitmap are undone.
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   files grow as they are written, but no further than MaxFileSize
+//	     (cf. filehdr.h)
+//	   names are at most FileNameMaxLen characters long; paths longer
+//	     than PathMaxLen work, but are not cached
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -52,20 +78,12 @@
 #include "filesys.h"
 #include "system.h"
 
-// Sectors containing the file headers for the bitmap of free sectors,
-// and the directory of files.  These file headers are placed in well-known 
-// sectors, so that they can be located on boot-up.
-#define FreeMapSector 		0
-#define DirectorySector 	1
-#define PipeSector          2
-
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
-#define FreeMapFileSize 	(NumSectors / BitsInByte)
+// Initial file sizes for the bitmap and directories; a directory grows
+// when all its entries are in use.
+#define FreeMapFileSize 	(divRoundUp(synchDisk->NumSectors(), BitsInWord) \
+				 * sizeof(int))
 #define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
-#define PipeFileSize        SectorSize
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -83,12 +101,13 @@
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    freeMapLock = new Lock("free map");
+    nameCache = new NameCache();
+    freeMap = new BitMap(synchDisk->NumSectors());
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
-    FileHeader *pipeHdr = new FileHeader;
 
 
         DEBUG('f', "Formatting the file system.\n");
@@ -97,14 +116,13 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
-    freeMap->Mark(PipeSector);
+	journal->Format(freeMap);	// reserves the end of the disk
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
 
-	ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
-	ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
-    ASSERT(pipeHdr->Allocate(freeMap, PipeFileSize));
+	ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize, FreeMapSector));
+	ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize, DirectorySector));
 
     // Flush the bitmap and directory FileHeaders back to disk
     // We need to do this before we can "Open" the file, since open
@@ -114,7 +132,6 @@ FileSystem::FileSystem(bool format)
         DEBUG('f', "Writing headers back to disk.\n");
 	mapHdr->WriteBack(FreeMapSector);    
 	dirHdr->WriteBack(DirectorySector);
-    pipeHdr->WriteBack(PipeSector);
 
     // OK to open the bitmap and directory files now
     // The file system operations assume these two files are left open
@@ -138,30 +155,152 @@ FileSystem::FileSystem(bool format)
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
-
-        delete freeMap; 
+	}
 	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
-	}
     } else {
     // if we are not formatting the disk, just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
+	journal->Recover();		// finish what a crash interrupted
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+	freeMap->FetchFrom(freeMapFile);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	De-allocate the in-memory free map.  It has no unwritten changes:
+//	every operation writes back what it changed before it releases
+//	the map.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    delete freeMap;
+    delete freeMapLock;
+    delete nameCache;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AcquireFreeMap
+// 	Wait until no one else is using the map of free sectors, and
+//	return it.  The caller may change it, and must call ReleaseFreeMap
+//	when done.
+//----------------------------------------------------------------------
+
+BitMap *
+FileSystem::AcquireFreeMap()
+{
+    freeMapLock->Acquire();
+    return freeMap;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReleaseFreeMap
+// 	Write whatever sectors of the free map were changed since the
+//	map was acquired back to its file, and let the next thread use it.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ReleaseFreeMap()
+{
+    freeMap->WriteDirty(freeMapFile);
+    freeMapLock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ForgetNames
+// 	Drop "path", and every path below it, from the name cache, for
+//	someone who changed the directory it names behind our back (cf.
+//	FileSystemChecker::Check).  "" is the root directory.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ForgetNames(char *path)
+{
+    nameCache->Invalidate(path);
+}
+
+//----------------------------------------------------------------------
+// BaseName
+// 	Return the last component of path name "name" ("c" in "a/b/c").
+//----------------------------------------------------------------------
+
+static char *
+BaseName(char *name)
+{
+    char *slash = strrchr(name, '/');
+
+    return (slash == NULL) ? name : slash + 1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenDir
+// 	Open the directory that path name "name" is in ("a/b" for
+//	"a/b/c"), and return it; return NULL if there is no such
+//	directory.
+//
+//	The directory's own path is looked up in the name cache first;
+//	only on a miss do we open its parent (the same way, recursively)
+//	and read the parent, under its directory lock, to find it, and
+//	then remember where it was.  So resolving a path whose directories
+//	were used recently reads no directories at all.
+//
+//	Either way the directory is opened while its name cannot be
+//	removed, and once it is open, Remove leaves it alone.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::OpenDir(char *name)
+{
+    char *slash = strrchr(name, '/');
+    char *prefix;
+    int sector;
+    Directory *directory;
+    OpenFile *dirFile, *parentFile;
+    RWLock *dirLock;
+
+    if (slash == NULL)
+	return new OpenFile(DirectorySector);	// in the root directory
+    prefix = new char[slash - name + 1];
+    strncpy(prefix, name, slash - name);
+    prefix[slash - name] = '\0';
+
+    dirFile = nameCache->Open(prefix);
+    if (dirFile == NULL) {
+	parentFile = OpenDir(prefix);
+	if (parentFile != NULL) {
+	    directory = new Directory(NumDirEntries);
+	    dirLock = headerTable->DirLock(parentFile->sector);
+	    dirLock->Acquire_r();
+	    directory->FetchFrom(parentFile);
+	    sector = directory->Find(BaseName(prefix));
+	    if (sector != -1) {
+		nameCache->Enter(prefix, sector);
+		dirFile = new OpenFile(sector);
+	    }
+	    dirLock->Release_r();
+	    delete parentFile;
+	    delete directory;
+	}
     }
+    delete [] prefix;
+    return dirFile;
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	The file is "initialSize" bytes long to start with, but sparse:
+//	its data sectors are only allocated as they are written (cf.
+//	filehdr.h).  A directory (initialSize -1) gets its sectors at once.
 //
 //	The steps to create a file are:
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
-// 	  Allocate space on disk for the data blocks for the file
+// 	  For a directory, allocate space on disk for its data blocks
 //	  Add the name to the directory
 //	  Store the new file header on disk 
 //	  Flush the changes to the bitmap and the directory back to disk
@@ -174,8 +313,8 @@ FileSystem::FileSystem(bool format)
 //	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
+//	The directory the file goes in is locked exclusively from before
+//	the name is looked up until the new entry is written back.
 //
 //	"name" -- name of file to be created
 //	"initialSize" -- size of file to be created
@@ -183,20 +322,68 @@ FileSystem::FileSystem(bool format)
 
 bool
 FileSystem::Create(char *name, int initialSize)
+{
+    bool success;
+
+    journal->Begin();			// all or nothing, if we crash
+    success = CreateFile(name, initialSize);
+    journal->End();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateFile
+// 	Do the work of Create, inside a journal handle.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CreateFile(char *name, int initialSize)
 {
     Directory *directory;
-    BitMap *freeMap;
-    FileHeader *hdr;
+    OpenFile *name_dir;
+    RWLock *dirLock;
     int sector;
-    bool success;
 
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
 
+    name_dir = OpenDir(name);
+    if(name_dir==NULL)
+        return false;			// no such directory
     directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    int name_sector = directory->FindDir(name);
-    OpenFile *name_dir = new OpenFile(name_sector);
+    dirLock = headerTable->DirLock(name_dir->sector);
+    dirLock->Acquire_w();
+    LOG('r', "Directory %d locked to create %s\n", name_dir->sector, name);
     directory->FetchFrom(name_dir);
+    sector = AddFile(directory, name, initialSize);
+    if (sector != -1) {
+        directory->WriteBack(name_dir);	// may grow, so not under the
+        				// free map lock
+        nameCache->Enter(name, sector);
+    }
+    dirLock->Release_w();
+    delete name_dir;
+    delete directory;
+    return sector != -1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AddFile
+// 	Allocate a header and data blocks for a new file "name" of
+//	"initialSize" bytes (a directory if initialSize is -1), and add it
+//	to "directory", the in-memory copy of the directory it goes in.
+//	The caller holds that directory's lock exclusively, and writes the
+//	directory back.
+//
+//	Return the sector of the new file's header, or -1 if the name is
+//	taken or there is no room.
+//----------------------------------------------------------------------
+
+int
+FileSystem::AddFile(Directory *directory, char *name, int initialSize)
+{
+    FileHeader *hdr;
+    int sector;
+
     char file_name[FileNameMaxLen+1];
     int pos=-1;
     for(int i=strlen(name)-1;i>=0;--i){
@@ -213,78 +400,55 @@ FileSystem::Create(char *name, int initialSize)
     }
     file_name[j]=0;
     if(directory->Find(file_name)!=-1)
-        return false;
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
+        return -1;
+    AcquireFreeMap();
     sector = freeMap->Find();
-    if(sector==-1)
-        return false;
+    if(sector==-1){
+        ReleaseFreeMap();
+        return -1;
+    }
     if(initialSize==-1){
-        if(!directory->Add(file_name,sector,0))
-            return false;
+        if(!directory->Add(file_name,sector,0)){
+            freeMap->Clear(sector);
+            ReleaseFreeMap();
+            return -1;
+        }
         hdr = new FileHeader;
         initialSize = DirectoryFileSize;
-        if(!hdr->Allocate(freeMap,initialSize)){
-            return false;
+        if(!hdr->Allocate(freeMap,initialSize,sector)){
+            freeMap->Clear(sector);
+            ReleaseFreeMap();
+            delete hdr;
+            return -1;
         }
-        success = true;
         hdr->set_create_time();
         hdr->WriteBack(sector);
         Directory *dir = new Directory(NumDirEntries);
         OpenFile *dir_file = new OpenFile(sector);
         dir->WriteBack(dir_file);
-        directory->WriteBack(name_dir);
-        freeMap->WriteBack(freeMapFile);
         delete hdr;
         delete dir;
         delete dir_file;
     }else{
-        if(!directory->Add(name,sector,1))
-            return false;
+        if(!directory->Add(name,sector,1)){
+            freeMap->Clear(sector);
+            ReleaseFreeMap();
+            return -1;
+        }
         hdr = new FileHeader;
-        if(!hdr->Allocate(freeMap,initialSize))
-            return false;
-        success=true;
+        if(!hdr->Allocate(freeMap,0,sector)	// sparse: sectors come
+              || !hdr->SetLength(initialSize)){	// with the first write
+            freeMap->Clear(sector);
+            ReleaseFreeMap();
+            delete hdr;
+            return -1;
+        }
         hdr->set_create_time();
         hdr->WriteBack(sector);
-        directory->WriteBack(name_dir);
-        freeMap->WriteBack(freeMapFile);
         delete hdr;
     }
-    delete freeMap;
-    delete name_dir;
-    delete directory;
-    return success;
-
-
-    //if (directory->Find(name) != -1)
-    //  success = FALSE;			// file is already in directory
-    //else {	
-    //    freeMap = new BitMap(NumSectors);
-    //    freeMap->FetchFrom(freeMapFile);
-    //    sector = freeMap->Find();	// find a sector to hold the file header
-    //	if (sector == -1) 		
-    //        success = FALSE;		// no free block for file header 
-    //    else if (!directory->Add(name, sector))
-    //        success = FALSE;	// no space in directory
-	//else {
-    //	    hdr = new FileHeader;
-	//    if (!hdr->Allocate(freeMap, initialSize))
-    //        	success = FALSE;	// no space on disk for data
-	//    else {	
-	//    	success = TRUE;
-    //        hdr->set_create_time();
-	//	// everthing worked, flush all changes back to disk
-    //	    	hdr->WriteBack(sector); 		
-    //	    	directory->WriteBack(directoryFile);
-    //	    	freeMap->WriteBack(freeMapFile);
-	//    }
-    //        delete hdr;
-	//}
-    //    delete freeMap;
-    //}
-    //delete directory;
-    //return success;
+    ReleaseFreeMap();
+    return sector;
 }
 
 //----------------------------------------------------------------------
@@ -294,44 +458,42 @@ FileSystem::Create(char *name, int initialSize)
 //	  Find the location of the file's header, using the directory 
 //	  Bring the header into memory
 //
+//	The file is opened while its directory is locked shared (or, if
+//	its path is in the name cache, while the cache is locked), so it
+//	cannot be removed in between.
+//
 //	"name" -- the text name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
-    OpenFile *openFile = NULL;
+    Directory *directory;
+    OpenFile *dirFile;
+    OpenFile *openFile;
+    RWLock *dirLock;
     int sector;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->FindDir(name);
-    directory = new Directory(NumDirEntries);
-    if(sector>=0){
-        openFile = new OpenFile(sector);
-    }
-    directory->FetchFrom(openFile);
-    char file_name[FileNameMaxLen+1];
-    int pos=-1;
-    for(int i=strlen(name)-1;i>=0;--i){
-        if(name[i]=='/'){
-            pos=i+1;
-            break;
-        }
-    }
-    if(pos==-1)
-        pos=0;
-    int j=0;
-    for(int i=pos;i<strlen(name);++i){
-        file_name[j++]=name[i];
+    openFile = nameCache->Open(name);
+    if (openFile == NULL) {
+	dirFile = OpenDir(name);
+	if (dirFile == NULL)
+	    return NULL;		// no such directory
+	directory = new Directory(NumDirEntries);
+	dirLock = headerTable->DirLock(dirFile->sector);
+	dirLock->Acquire_r();
+	directory->FetchFrom(dirFile);
+	sector = directory->Find(BaseName(name));
+	if (sector >= 0) {
+	    nameCache->Enter(name, sector);
+	    openFile = new OpenFile(sector);	// name was found in directory 
+	}
+	dirLock->Release_r();
+	delete dirFile;
+	delete directory;
     }
-    file_name[j]=0;
-    sector = directory->Find(file_name);
-    if(sector>=0)
-        openFile = new OpenFile(sector);
-    delete directory;
-    return openFile;
+    return openFile;				// return NULL if not found
 
     //sector = directory->Find(name); 
     //if (sector >= 0) 		
@@ -345,8 +507,8 @@ FileSystem::Open(char *name)
 // 	Delete a file from the file system.  This requires:
 //	    Remove it from the directory
 //	    Delete the space for its header
-//	    Delete the space for its data blocks
-//	    Write changes to directory, bitmap back to disk
+//	    Delete the space for its data blocks (once this commits)
+//	    Write changes to directory back to disk
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
@@ -356,20 +518,37 @@ FileSystem::Open(char *name)
 
 bool
 FileSystem::Remove(char *name)
+{
+    bool success;
+
+    journal->Begin();			// all or nothing, if we crash
+    success = RemoveFile(name);
+    journal->End();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RemoveFile
+// 	Do the work of Remove, inside a journal handle.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::RemoveFile(char *name)
 { 
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
-    OpenFile *openFile = NULL;
+    OpenFile *openFile;
+    OpenFile *current_openFile = NULL;
+    RWLock *dirLock, *current_dirLock = NULL;
     int sector;
-    int dir_sector;
     
+    openFile = OpenDir(name);
+    if(openFile==NULL)
+        return FALSE;			// no such directory
     directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    dir_sector = directory->FindDir(name);
-    directory = new Directory(NumDirEntries);
-    if(dir_sector>=0)
-        openFile = new OpenFile(dir_sector);
+    dirLock = headerTable->DirLock(openFile->sector);
+    dirLock->Acquire_w();
+    LOG('r', "Directory %d locked to remove %s\n", openFile->sector, name);
     directory->FetchFrom(openFile);
     char file_name[FileNameMaxLen+1];
     int pos=-1;
@@ -388,46 +567,116 @@ FileSystem::Remove(char *name)
     file_name[j]=0;
     sector = directory->Find(file_name);
     if (sector == -1) {
+       dirLock->Release_w();
        delete directory;
+       delete openFile;
        return FALSE;			 // file not found 
     }
+    nameCache->Invalidate(name);	// from now on, no one can open it
     
     if(directory->getType(file_name)==0){
         Directory *current_directory = new Directory(NumDirEntries);
-        OpenFile *current_openFile = new OpenFile(sector);
+        current_openFile = new OpenFile(sector);
+        current_dirLock = headerTable->DirLock(sector);
+        current_dirLock->Acquire_w();	// nothing may be added to it now
         current_directory->FetchFrom(current_openFile);
-        if(!current_directory->isEmpty()){
+        bool empty = current_directory->isEmpty();
+        delete current_directory;
+        if(!empty){
             printf("the dir isn't empty, can't remove\n");
-            delete current_directory;
+            current_dirLock->Release_w();
             delete current_openFile;
+            dirLock->Release_w();
+            delete directory;
+            delete openFile;
             return false;
         }
-        delete current_directory;
-        delete current_openFile;
     }
-    printf("vistors: %d\n",synchDisk->numVisitors[sector]);
-    if(synchDisk->numVisitors[sector]){
+    if(headerTable->NumOpens(sector) > (current_openFile != NULL)){
         printf("remain vistors, can't remove\n");
+        if(current_openFile != NULL){
+            current_dirLock->Release_w();
+            delete current_openFile;
+        }
+        dirLock->Release_w();
+        delete directory;
+        delete openFile;
         return false;
     }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
-
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
-    freeMap->Clear(sector);			// remove header block
+    fileHdr->Deallocate();  			// remove data blocks
+    journal->Free(sector);			// remove header block
     directory->Remove(file_name);
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
     directory->WriteBack(openFile);        // flush to disk
+    if(current_openFile != NULL){
+        current_dirLock->Release_w();
+        delete current_openFile;
+    }
+    dirLock->Release_w();
     delete fileHdr;
     delete directory;
-    delete freeMap;
+    delete openFile;
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::CreateTemporary
+// 	Create an empty file that is in no directory, and return it open;
+//	it grows as it is written, like any other file.  Return NULL if
+//	there is no free sector for its header.
+//
+//	The file exists only as long as the caller keeps it: it must be
+//	given back with RemoveTemporary.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::CreateTemporary()
+{
+    FileHeader *hdr;
+    int sector;
+
+    journal->Begin();
+    AcquireFreeMap();
+    sector = freeMap->Find();
+    if (sector != -1) {
+	hdr = new FileHeader;
+	ASSERT(hdr->Allocate(freeMap, 0, sector));
+	hdr->set_create_time();
+	hdr->WriteBack(sector);
+	delete hdr;
+    }
+    ReleaseFreeMap();
+    journal->End();
+    DEBUG('f', "Created temporary file, header at %d\n", sector);
+    return (sector == -1) ? NULL : new OpenFile(sector);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RemoveTemporary
+// 	Close a file made by CreateTemporary, and give its sectors back.
+//	No one else may have it open.
+//----------------------------------------------------------------------
+
+void
+FileSystem::RemoveTemporary(OpenFile *file)
+{
+    int sector = file->sector;
+    FileHeader *hdr = new FileHeader;
+
+    delete file;
+    ASSERT(headerTable->NumOpens(sector) == 0);
+    journal->Begin();
+    hdr->FetchFrom(sector);
+    hdr->Deallocate();
+    journal->Free(sector);
+    journal->End();
+    delete hdr;
+    DEBUG('f', "Removed temporary file, header at %d\n", sector);
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
 // 	List all the files in the file system directory.
@@ -437,8 +686,11 @@ void
 FileSystem::List()
 {
     Directory *directory = new Directory(NumDirEntries);
+    RWLock *dirLock = headerTable->DirLock(DirectorySector);
 
+    dirLock->Acquire_r();
     directory->FetchFrom(directoryFile);
+    dirLock->Release_r();
     directory->List();
     delete directory;
 }
@@ -458,7 +710,6 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
     Directory *directory = new Directory(NumDirEntries);
 
     printf("Bit map file header:\n");
@@ -469,38 +720,16 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
+    AcquireFreeMap();
     freeMap->Print();
+    ReleaseFreeMap();
 
+    headerTable->DirLock(DirectorySector)->Acquire_r();
     directory->FetchFrom(directoryFile);
+    headerTable->DirLock(DirectorySector)->Release_r();
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 } 
-
-
-int FileSystem::ReadPipe(char* data){
-    FileHeader* fileHdr;
-    fileHdr=new FileHeader;
-    fileHdr->FetchFrom(PipeSector);
-    int length = fileHdr->FileLength();
-    fileHdr->WriteBack(PipeSector);
-    OpenFile *pipe_file = new OpenFile(PipeSector);
-    pipe_file->Read(data,length);
-    delete pipe_file;
-    return length;
-}
-
-void FileSystem::WritePipe(char* data,int length){
-    OpenFile *pipe_file = new OpenFile(PipeSector);
-    pipe_file->Write(data,length);
-    delete pipe_file;
-    FileHeader *fileHdr;
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(PipeSector);
-    fileHdr->numBytes = length;
-    fileHdr->WriteBack(PipeSector);
-}
@@ -65,6 +65,17 @@ class FileSystem {
 };
 
 #else // FILESYS
+// Sectors containing the file headers for the bitmap of free sectors,
+// and the directory of files.  These file headers are placed in well-known 
+// sectors, so that they can be located on boot-up.
+#define FreeMapSector 		0
+#define DirectorySector 	1
+
+class BitMap;
+class Directory;
+class Lock;
+class NameCache;
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -73,6 +84,7 @@ class FileSystem {
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+    ~FileSystem();
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
@@ -85,12 +97,38 @@ class FileSystem {
 
     void Print();			// List all the files and their contents
 
-    int ReadPipe(char *data);
-    void WritePipe(char* data, int length);
+    OpenFile *CreateTemporary();	// Create and open an empty file with
+					// no name (cf. Pipe); NULL if the
+					// disk is full
+    void RemoveTemporary(OpenFile *file);
+					// Close it, and free its space
+
+    BitMap *AcquireFreeMap();		// Get exclusive use of the map of
+					// free sectors
+    void ReleaseFreeMap();		// Write the sectors of the map that
+					// changed back to disk, and let
+					// someone else use it
+    void ForgetNames(char *path);	// drop "path", and the paths below
+					// it, from the name cache
 
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
+   BitMap *freeMap;			// The bit map itself, kept in
+					// memory while Nachos is running
+   Lock *freeMapLock;			// Held by whoever is using freeMap
+   NameCache *nameCache;		// Where recently used path names
+					// have their file headers
+
+   OpenFile *OpenDir(char *name);	// Open the directory holding path
+					// "name"; NULL if there is none
+   bool CreateFile(char *name, int initialSize);
+   bool RemoveFile(char *name);		// Create and Remove, less the
+					// journal handle
+   int AddFile(Directory *directory, char *name, int initialSize);
+					// allocate a new file and enter it
+					// in "directory"; its header sector,
+					// or -1
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
 };
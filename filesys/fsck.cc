@@ -0,0 +1,528 @@
+// fsck.cc
+//	Routines to check the file system on the disk for consistency,
+//	and to repair what can be repaired (cf. fsck.h).
+//
+//	The check goes in three steps:
+//
+//	   claim the sectors that belong to no file: the journal's, and
+//	     the headers of the free map and the root directory
+//	   scan every directory, starting at the root, claiming the
+//	     headers, index blocks and data sectors of everything in it
+//	   claim the same for the files that are open but in no
+//	     directory, such as the spill files of pipes
+//	   compare the sectors claimed with the free map
+//
+//	Nothing is written until all the scanning threads are done; then
+//	the repairs are made by the thread that called Check, inside its
+//	journal handle, so they are committed together.  A directory is
+//	rewritten under its directory lock, and the names that were in it
+//	are dropped from the name cache.
+
+#include "copyright.h"
+#include "fsck.h"
+#include "filehdr.h"
+#include "directory.h"
+#include "filesys.h"
+#include "journal.h"
+#include "system.h"
+#include "stdarg.h"
+
+// A directory waiting to be scanned.
+class PendingDirectory {
+  public:
+    int sector;				// where its header is
+    char *path;				// its full path name
+};
+
+// A directory with bad entries taken out, waiting to be written back.
+class DirectoryRepair {
+  public:
+    int hdrSector;			// where its header is
+    char *path;				// its full path name
+    int numSectors;
+    int *sectors;			// its data sectors (0 for a hole)
+    char *data;				// their new contents
+};
+
+//----------------------------------------------------------------------
+// CheckerThread
+// 	Body of a directory scanning thread.  Need this to be a C routine,
+//	because Thread::Fork can't take a pointer to a member function.
+//----------------------------------------------------------------------
+
+static void
+CheckerThread(int arg)
+{
+    FileSystemChecker *checker = (FileSystemChecker *) arg;
+
+    checker->ScanDirectories();
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::FileSystemChecker
+// 	Initialize a checker; nothing is looked at until Check.
+//
+//	"repair" -- should Check fix the problems it finds?
+//----------------------------------------------------------------------
+
+FileSystemChecker::FileSystemChecker(bool doRepair)
+{
+    repair = doRepair;
+    owner = new int[synchDisk->NumSectors()];
+    for (int i = 0; i < synchDisk->NumSectors(); i++)
+	owner[i] = NoOwner;
+    pending = new List;
+    repairs = new List;
+    busy = 0;
+    lock = new Lock("fsck lock");
+    workChanged = new Condition("fsck work changed");
+    threadsDone = new Semaphore("fsck threads done", 0);
+
+    numFiles = numDirectories = 0;
+    numDataSectors = numIndexBlocks = numHoles = 0;
+    numExtents = numFragmented = 0;
+    numErrors = numDuplicates = numBadEntries = 0;
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::~FileSystemChecker
+// 	De-allocate the checker.
+//----------------------------------------------------------------------
+
+FileSystemChecker::~FileSystemChecker()
+{
+    delete [] owner;
+    delete pending;			// emptied by Check
+    delete repairs;
+    delete lock;
+    delete workChanged;
+    delete threadsDone;
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::Check
+// 	Check the whole file system, repair it if asked to, and print
+//	what was found.  Return TRUE if nothing was wrong.
+//
+//	The check holds an exclusive journal handle from start to finish:
+//	every update that allocates or frees sectors runs in a handle, so
+//	none is half done while we look, and none starts until we are
+//	through.  (Otherwise a sector allocated but not yet in a directory
+//	would look leaked, and repair would free it again.)  Sectors an
+//	update has freed stay marked until its transaction commits (cf.
+//	Journal::Free); they are not leaks either.
+//----------------------------------------------------------------------
+
+bool
+FileSystemChecker::Check()
+{
+    FileHeader *hdr = new FileHeader;
+    PendingDirectory *root = new PendingDirectory;
+    BitMap *freeMap;
+    int *sectors;
+    int numLeaks = 0, numUnmarked = 0;
+
+    journal->BeginExclusive();		// wait for updates under way
+
+    for (int i = journal->Start(); i < synchDisk->NumSectors(); i++)
+	owner[i] = SystemOwner;
+    Claim(FreeMapSector, FreeMapSector, "header", "(free map)");
+    Claim(DirectorySector, DirectorySector, "header", "/");
+    hdr->FetchFrom(FreeMapSector);
+    sectors = CheckFile(FreeMapSector, "(free map)", hdr);
+    if (sectors != NULL && hdr->FileLength()
+			    < divRoundUp(synchDisk->NumSectors(), BitsInByte))
+	Error("(free map): too short to map the disk\n");
+    delete [] sectors;
+    delete hdr;
+
+    root->sector = DirectorySector;
+    root->path = new char[2];
+    strcpy(root->path, "/");
+    pending->Append((void *) root);
+    for (int i = 0; i < CheckerThreads; i++) {
+	Thread *t = new Thread("fsck");
+	t->Fork(CheckerThread, (int) this);
+    }
+    for (int i = 0; i < CheckerThreads; i++)
+	threadsDone->P();
+
+    for (int i = 0; i < journal->Start(); i++)
+	if (owner[i] == NoOwner && headerTable->NumOpens(i) > 0) {
+	    hdr = new FileHeader;	// open, but in no directory
+	    Claim(i, i, "header", "(temporary)");
+	    hdr->FetchFrom(i);
+	    delete [] CheckFile(i, "(temporary)", hdr);
+	    numFiles++;
+	    delete hdr;
+	}
+
+    while (!repairs->IsEmpty()) {	// write back fixed directories
+	DirectoryRepair *fix = (DirectoryRepair *) repairs->Remove();
+	RWLock *dirLock;
+
+	headerTable->Open(fix->hdrSector);	// for its directory lock
+	dirLock = headerTable->DirLock(fix->hdrSector);
+	dirLock->Acquire_w();		// no lookups in it meanwhile
+	for (int i = 0; i < fix->numSectors; i++)
+	    if (fix->sectors[i] != 0)
+		synchDisk->WriteSector(fix->sectors[i],
+					&fix->data[i * SectorSize]);
+	fileSystem->ForgetNames(fix->path + 1);	// no leading "/"
+	dirLock->Release_w();
+	headerTable->Close(fix->hdrSector);
+	delete [] fix->path;
+	delete [] fix->sectors;
+	delete [] fix->data;
+	delete fix;
+    }
+
+    freeMap = fileSystem->AcquireFreeMap();	// after the directory locks
+
+    for (int i = 0; i < synchDisk->NumSectors(); i++) {
+	bool used = (owner[i] != NoOwner);
+
+	if (freeMap->Test(i) && !used && !journal->Freeing(i)) {
+	    Error("sector %d is marked in use, but nothing uses it\n", i);
+	    numLeaks++;
+	    if (repair)
+		freeMap->Clear(i);
+	} else if (!freeMap->Test(i) && used) {
+	    Error("sector %d is used by the file at sector %d, but marked "
+		  "free\n", i, owner[i]);
+	    numUnmarked++;
+	    if (repair)
+		freeMap->Mark(i);
+	}
+    }
+
+    printf("%d files, %d directories\n", numFiles, numDirectories);
+    printf("%d data sectors, %d index blocks, %d holes, %d sectors free\n",
+	numDataSectors, numIndexBlocks, numHoles, freeMap->NumClear());
+    printf("%d extents, %d.%02d per file; %d files in more than one\n",
+	numExtents, numExtents / max(numFiles + numDirectories, 1),
+	numExtents * 100 / max(numFiles + numDirectories, 1) % 100,
+	numFragmented);
+    printf("%d errors: %d duplicate sectors, %d leaked, %d marked free, "
+	"%d bad directory entries\n", numErrors, numDuplicates, numLeaks,
+	numUnmarked, numBadEntries);
+    if (repair && numErrors > 0)
+	printf("Leaks, free map entries and directory entries repaired; "
+	       "duplicates must be fixed by hand\n");
+
+    fileSystem->ReleaseFreeMap();
+    journal->End();
+    return numErrors == 0;
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::ScanDirectories
+// 	Scan directories off the queue until it is empty and no thread is
+//	scanning one, since it might still find more.
+//----------------------------------------------------------------------
+
+void
+FileSystemChecker::ScanDirectories()
+{
+    PendingDirectory *dir;
+
+    lock->Acquire();
+    for (;;) {
+	while (pending->IsEmpty() && busy > 0)
+	    workChanged->Wait(lock);
+	if (pending->IsEmpty())
+	    break;				// all done
+	dir = (PendingDirectory *) pending->Remove();
+	busy++;
+	lock->Release();
+
+	ScanDirectory(dir->sector, dir->path);
+	delete [] dir->path;
+	delete dir;
+
+	lock->Acquire();
+	busy--;
+	workChanged->Broadcast(lock);
+    }
+    lock->Release();
+    threadsDone->V();
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::Claim
+// 	Record that "sector" is used by the file whose header is at
+//	"hdrSector", as its "what".  Return FALSE, and report it, if the
+//	sector is not on the disk, or something else has it already; the
+//	caller must then not follow it.
+//----------------------------------------------------------------------
+
+bool
+FileSystemChecker::Claim(int sector, int hdrSector, char *what, char *path)
+{
+    int other;
+
+    if (sector < 0 || sector >= synchDisk->NumSectors()) {
+	Error("%s: %s sector %d is not on the disk\n", path, what, sector);
+	return FALSE;
+    }
+    lock->Acquire();
+    other = owner[sector];
+    if (other == NoOwner)
+	owner[sector] = hdrSector;
+    else
+	numDuplicates++;
+    lock->Release();
+
+    if (other == SystemOwner)
+	Error("%s: %s sector %d is in the journal\n", path, what, sector);
+    else if (other != NoOwner)
+	Error("%s: %s sector %d is also used by the file at sector %d\n",
+						path, what, sector, other);
+    return other == NoOwner;
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::CheckFile
+// 	Check the header "hdr" of the file at "hdrSector" (already
+//	claimed), claim everything it points to, and print how the file
+//	is laid out.  Return the disk sector of each of its data sectors,
+//	0 for a hole or a sector that could not be claimed; or NULL if
+//	the header is too damaged to follow.
+//
+//	"path" -- the file's name, for the report
+//----------------------------------------------------------------------
+
+int *
+FileSystemChecker::CheckFile(int hdrSector, char *path, FileHeader *hdr)
+{
+    int numSectors = hdr->numSectors;
+    int *sectors;
+    int first = NumDirect, span = 1;
+    int data = 0, holes = 0, extents = 0, last = -1;
+
+    if (hdr->numBytes < 0 || hdr->numBytes > MaxFileSize
+	    || numSectors != divRoundUp(hdr->numBytes, SectorSize)) {
+	Error("%s: header at sector %d has a bad length\n", path, hdrSector);
+	return NULL;
+    }
+    sectors = new int[numSectors];
+    bzero((char *) sectors, numSectors * sizeof(int));
+
+    for (int i = 0; i < NumDirect; i++) {
+	if (hdr->dataSectors[i] == 0)
+	    continue;
+	if (i >= numSectors)
+	    Error("%s: data sector %d is past the end of the file\n",
+							path, i);
+	else if (Claim(hdr->dataSectors[i], hdrSector, "data", path))
+	    sectors[i] = hdr->dataSectors[i];
+    }
+    for (int d = 1; d <= NumIndirect; d++) {
+	span *= PointersPerSector;
+	if (hdr->indirect[d - 1] != 0) {
+	    if (first >= numSectors)
+		Error("%s: index tree %d is past the end of the file\n",
+							path, d);
+	    else
+		CheckTree(hdr->indirect[d - 1], d, hdrSector, path,
+						sectors, first, numSectors);
+	}
+	first += span;
+    }
+
+    for (int i = 0; i < numSectors; i++) {
+	if (sectors[i] == 0) {
+	    holes++;
+	    continue;
+	}
+	if (sectors[i] != last + 1)
+	    extents++;			// a new run starts here
+	last = sectors[i];
+	data++;
+    }
+    printf("%s: %d bytes, %d sectors, %d holes, %d extents\n", path,
+				hdr->numBytes, numSectors, holes, extents);
+
+    lock->Acquire();
+    numDataSectors += data;
+    numHoles += holes;
+    numExtents += extents;
+    if (extents > 1)
+	numFragmented++;
+    lock->Release();
+    return sectors;
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::CheckTree
+// 	Claim the index tree "depth" levels deep rooted at "sector", and
+//	the data sectors it lists, filling them into "sectors".  The tree
+//	lists the data sectors of the file from "first" on.  A depth of 0
+//	is just a data sector.
+//----------------------------------------------------------------------
+
+void
+FileSystemChecker::CheckTree(int sector, int depth, int hdrSector,
+		char *path, int *sectors, int first, int numSectors)
+{
+    int table[PointersPerSector];
+    int span = 1;			// data sectors under each entry
+
+    if (depth == 0) {
+	if (Claim(sector, hdrSector, "data", path))
+	    sectors[first] = sector;
+	return;
+    }
+    if (!Claim(sector, hdrSector, "index", path))
+	return;
+    lock->Acquire();
+    numIndexBlocks++;
+    lock->Release();
+
+    for (int d = 1; d < depth; d++)
+	span *= PointersPerSector;
+    synchDisk->ReadSector(sector, (char *) table);
+    for (int i = 0; i < PointersPerSector; i++) {
+	if (table[i] == 0)
+	    continue;
+	if (first + i * span >= numSectors)
+	    Error("%s: index block %d lists sectors past the end of the "
+		  "file\n", path, sector);
+	else
+	    CheckTree(table[i], depth - 1, hdrSector, path, sectors,
+					first + i * span, numSectors);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::ScanDirectory
+// 	Check the directory whose header is at "hdrSector" (already
+//	claimed), and everything in it: claim the headers it names,
+//	check the files, and queue the directories for scanning.
+//
+//	The directory is read straight from its data sectors, since its
+//	header may not be fit for OpenFile.  Entries that make no sense
+//	are reported, and, when repairing, taken out of the directory.
+//
+//	"path" -- the directory's name, for the report
+//----------------------------------------------------------------------
+
+void
+FileSystemChecker::ScanDirectory(int hdrSector, char *path)
+{
+    FileHeader *hdr = new FileHeader;
+    DirectoryEntry *table;
+    int *sectors, *fileSectors;
+    int numSectors, numEntries;
+    char *data, *name;
+    bool changed = FALSE;
+
+    hdr->FetchFrom(hdrSector);
+    sectors = CheckFile(hdrSector, path, hdr);
+    lock->Acquire();
+    numDirectories++;
+    lock->Release();
+    if (sectors == NULL) {
+	delete hdr;
+	return;
+    }
+    numSectors = hdr->numSectors;
+    numEntries = hdr->FileLength() / sizeof(DirectoryEntry);
+    data = new char[numSectors * SectorSize];
+    for (int i = 0; i < numSectors; i++)
+	if (sectors[i] != 0)
+	    synchDisk->ReadSector(sectors[i], &data[i * SectorSize]);
+	else
+	    bzero(&data[i * SectorSize], SectorSize);
+    table = (DirectoryEntry *) data;
+
+    for (int i = 0; i < numEntries; i++) {
+	DirectoryEntry *entry = &table[i];
+
+	if (!entry->inUse)
+	    continue;
+	if (memchr(entry->name, '\0', FileNameMaxLen + 1) == NULL
+		|| entry->name[0] == '\0'
+		|| (entry->type != 0 && entry->type != 1)
+		|| entry->sector <= DirectorySector
+		|| entry->sector >= synchDisk->NumSectors()) {
+	    Error("%s: entry %d is damaged\n", path, i);
+	    lock->Acquire();
+	    numBadEntries++;
+	    lock->Release();
+	    if (repair) {
+		entry->inUse = FALSE;
+		changed = TRUE;
+	    }
+	    continue;
+	}
+
+	name = new char[strlen(path) + FileNameMaxLen + 2];
+	if (hdrSector == DirectorySector)
+	    sprintf(name, "/%s", entry->name);
+	else
+	    sprintf(name, "%s/%s", path, entry->name);
+	if (!Claim(entry->sector, entry->sector, "header", name)) {
+	    delete [] name;
+	    continue;
+	}
+	if (entry->type == 0) {		// a directory: scan it later
+	    PendingDirectory *dir = new PendingDirectory;
+
+	    dir->sector = entry->sector;
+	    dir->path = name;
+	    lock->Acquire();
+	    pending->Append((void *) dir);
+	    workChanged->Broadcast(lock);
+	    lock->Release();
+	} else {
+	    FileHeader *fileHdr = new FileHeader;
+
+	    fileHdr->FetchFrom(entry->sector);
+	    fileSectors = CheckFile(entry->sector, name, fileHdr);
+	    lock->Acquire();
+	    numFiles++;
+	    lock->Release();
+	    delete [] fileSectors;
+	    delete fileHdr;
+	    delete [] name;
+	}
+    }
+
+    if (changed) {
+	DirectoryRepair *fix = new DirectoryRepair;
+
+	fix->hdrSector = hdrSector;
+	fix->path = new char[strlen(path) + 1];
+	strcpy(fix->path, path);
+	fix->numSectors = numSectors;
+	fix->sectors = sectors;
+	fix->data = data;
+	lock->Acquire();
+	repairs->Append((void *) fix);
+	lock->Release();
+    } else {
+	delete [] sectors;
+	delete [] data;
+    }
+    delete hdr;
+}
+
+//----------------------------------------------------------------------
+// FileSystemChecker::Error
+// 	Print a problem with the file system, printf style, and count it.
+//----------------------------------------------------------------------
+
+void
+FileSystemChecker::Error(char *format, ...)
+{
+    va_list ap;
+
+    lock->Acquire();
+    numErrors++;
+    lock->Release();
+    printf("fsck: ");
+    va_start(ap, format);
+    vfprintf(stdout, format, ap);
+    va_end(ap);
+}
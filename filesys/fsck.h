@@ -0,0 +1,97 @@
+// fsck.h
+//	Data structures for checking that the file system is consistent,
+//	in the manner of UNIX fsck.
+//
+//	The checker walks every directory from the root, and every file
+//	header it finds, and works out which file (if any) each sector of
+//	the disk belongs to.  It reports:
+//
+//	   sectors used by two files, or twice by one ("duplicates")
+//	   sectors that are used but marked free in the free map
+//	   sectors marked in use that nothing uses ("leaks")
+//	   file headers and directory entries that make no sense
+//
+//	and, for each file, how many extents (runs of consecutive
+//	sectors) its data is in, with a summary for the whole disk, so
+//	that fragmentation can be measured.
+//
+//	In repair mode, it makes the free map agree with what is actually
+//	used, and takes bad entries out of their directories.  Duplicates
+//	are only reported: there is no telling which file is right.
+//
+//	Everything is read straight from the disk (through the buffer
+//	cache), checking each sector number before it is followed, so a
+//	damaged file system cannot crash the checker.  Other threads may
+//	use the file system meanwhile: the check waits for the metadata
+//	updates under way to finish, and keeps new ones waiting until it
+//	is done (cf. Journal::BeginExclusive), so it sees every file
+//	either before or after each update.
+//
+//	Directories are scanned by several threads taking them from a
+//	shared queue, so that while one waits for the disk, another can
+//	queue its requests too, and the disk scheduler can order them.
+
+#ifndef FSCK_H
+#define FSCK_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "list.h"
+#include "synch.h"
+#include "bitmap.h"
+
+#define CheckerThreads	4		// directories scanned at once
+
+#define NoOwner		(-1)		// owner[] of a sector no one uses
+#define SystemOwner	(-2)		// owner[] of the journal's sectors
+
+class FileHeader;
+
+// The following class checks, and optionally repairs, the file system
+// on the disk.
+class FileSystemChecker {
+  public:
+    FileSystemChecker(bool repair);	// "repair" -- fix what can be fixed
+    ~FileSystemChecker();
+
+    bool Check();			// check the whole file system, print
+					// the report, and return TRUE if no
+					// errors were found
+
+    void ScanDirectories();		// body of each scanning thread
+
+  private:
+    bool repair;
+    int *owner;				// for each sector, the header sector
+					// of the file that uses it
+    List *pending;			// directories waiting to be scanned
+    List *repairs;			// directories waiting to be written
+					// back without their bad entries
+    int busy;				// threads scanning one right now
+    Lock *lock;				// protects everything above and the
+					// counts below
+    Condition *workChanged;		// a directory was queued, or a
+					// thread finished one
+    Semaphore *threadsDone;
+
+    int numFiles, numDirectories;	// counts for the report
+    int numDataSectors, numIndexBlocks, numHoles;
+    int numExtents, numFragmented;
+    int numErrors, numDuplicates, numBadEntries;
+
+    bool Claim(int sector, int hdrSector, char *what, char *path);
+					// record that "sector" is used by
+					// the file at hdrSector; FALSE if
+					// it is out of range or taken
+    int *CheckFile(int hdrSector, char *path, FileHeader *hdr);
+					// check a file's header and claim its
+					// sectors; return its data sectors
+    void CheckTree(int sector, int depth, int hdrSector, char *path,
+		   int *sectors, int first, int numSectors);
+					// claim an index tree and its data
+    void ScanDirectory(int hdrSector, char *path);
+					// check the entries of a directory
+    void Error(char *format, ...);	// report an error, and count it
+};
+
+#endif // FSCK_H
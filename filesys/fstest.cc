@@ -4,9 +4,18 @@
 //	We implement:
 //	   Copy -- copy a file from UNIX to Nachos
 //	   Print -- cat the contents of a Nachos file 
+//	   Check -- check (and repair) the file system on the disk
+//	   Defragment -- defragment the file system in the background
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   ReadAheadTest -- read a file sequentially, faster than it can
+//		be read ahead
+//	   PipeTest -- stream data through a kernel pipe
+//	   DirectoryTest -- create, write and open files in one directory
+//		from several threads at once
+//	   JournalTest -- crash after removing a file, and check that
+//		replaying the journal brings it back intact
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -20,6 +29,10 @@
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "bufcache.h"
+#include "pipe.h"
+#include "fsck.h"
+#include "defrag.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -100,6 +113,34 @@ Print(char *name)
     return;
 }
 
+//----------------------------------------------------------------------
+// Check
+// 	Check the file system on the disk for consistency (cf. fsck.h),
+//	and if "repair", fix what can be fixed.
+//----------------------------------------------------------------------
+
+void
+Check(bool repair)
+{
+    FileSystemChecker *checker = new FileSystemChecker(repair);
+
+    if (checker->Check())
+	printf("File system is consistent\n");
+    delete checker;
+}
+
+//----------------------------------------------------------------------
+// Defragment
+// 	Start defragmenting the file system (cf. defrag.h).  It goes on
+//	in the background, while whatever comes next runs.
+//----------------------------------------------------------------------
+
+void
+Defragment()
+{
+    (void) new Defragmenter;
+}
+
 //----------------------------------------------------------------------
 // PerformanceTest
 // 	Stress the Nachos file system by creating a large file, writing
@@ -209,15 +250,308 @@ void PerformanceTest(){
     fileSystem->Remove(FileName);
 }
 
-void Test1(){
-    char input_str[SectorSize+1];
-    printf("input: ");
-    scanf("%s",input_str);
-    fileSystem->WritePipe(input_str,strlen(input_str));
+//----------------------------------------------------------------------
+// ReadAheadTest
+// 	Write a file, then enough other files to push it out of the
+//	buffer cache, and read it back a sector at a time.  Every read
+//	asks the read-ahead thread for the next few sectors; the reader
+//	catches up with it as soon as its own read is done, and has to
+//	wait for the sector the thread is still reading.  Check that
+//	every byte comes back.
+//----------------------------------------------------------------------
+
+#define ReadAheadSectors 20		// small enough for any file header
+#define ReadAheadSize	(ReadAheadSectors * SectorSize)
+#define ReadAheadFillers (divRoundUp(CacheSize, ReadAheadSectors) + 1)
+
+static bool
+WritePattern(char *name)
+{
+    OpenFile *openFile;
+    char sector[SectorSize];
+    bool ok = TRUE;
+
+    if (!fileSystem->Create(name, ReadAheadSize)
+		|| (openFile = fileSystem->Open(name)) == NULL) {
+	printf("Read-ahead test: can't create %s\n", name);
+	return FALSE;
+    }
+    for (int i = 0; ok && i < ReadAheadSize; i += SectorSize) {
+	for (int j = 0; j < SectorSize; j++)
+	    sector[j] = (char) ((i + j) % 251);
+	ok = (openFile->Write(sector, SectorSize) == SectorSize);
+    }
+    if (!ok)
+	printf("Read-ahead test: can't write %s\n", name);
+    delete openFile;
+    return ok;
+}
+
+void
+ReadAheadTest()
+{
+    OpenFile *openFile;
+    char sector[SectorSize], name[16];
+    int i, j, readAheads = stats->numReadAheads;
+    bool ok = WritePattern("ReadAhead");
+
+    printf("Sequential read of %d byte file, one sector at a time\n",
+	   ReadAheadSize);
+    for (i = 0; ok && i < ReadAheadFillers; i++) {
+	sprintf(name, "ReadAhead%d", i);
+	ok = WritePattern(name);
+    }
+    if (ok && (openFile = fileSystem->Open("ReadAhead")) != NULL) {
+	for (i = 0; ok && i < ReadAheadSize; i += SectorSize) {
+	    if (openFile->Read(sector, SectorSize) != SectorSize) {
+		printf("Read-ahead test: read failed at %d\n", i);
+		ok = FALSE;
+	    }
+	    for (j = 0; ok && j < SectorSize; j++)
+		if (sector[j] != (char) ((i + j) % 251)) {
+		    printf("Read-ahead test: wrong byte at %d\n", i + j);
+		    ok = FALSE;
+		}
+	}
+	delete openFile;
+    }
+    fileSystem->Remove("ReadAhead");
+    for (i = 0; i < ReadAheadFillers; i++) {
+	sprintf(name, "ReadAhead%d", i);
+	fileSystem->Remove(name);
+    }
+    printf("Read-ahead test: %d sectors read ahead%s\n",
+	   stats->numReadAheads - readAheads, ok ? ", ok" : ", FAILED");
+}
+
+//----------------------------------------------------------------------
+// PipeTest
+// 	Stream PipeTestSize bytes through a kernel pipe, from a forked
+//	writer to a reader that reads in smaller pieces and gives up the
+//	CPU after each, so the writer gets ahead and the backlog spills
+//	to disk.  Check that every byte comes out once, in order.
+//----------------------------------------------------------------------
+
+#define PipeTestSize	(8 * PipeBufferSize)
+#define PipeTestChunk	100
+
+static void
+PipeWriter(int arg)
+{
+    KernelPipe *pipe = (KernelPipe *) arg;
+    char chunk[PipeTestChunk];
+    int i, n;
+
+    for (i = 0; i < PipeTestSize; i += n) {
+	n = min(PipeTestChunk, PipeTestSize - i);
+	for (int j = 0; j < n; j++)
+	    chunk[j] = (char) ((i + j) % 251);
+	if (pipe->Write(chunk, n) != n) {
+	    printf("Pipe test: write failed at %d\n", i);
+	    break;
+	}
+    }
+    pipe->CloseWriter();
+}
+
+void
+PipeTest()
+{
+    KernelPipe *pipe = new KernelPipe();
+    Thread *writer = new Thread("pipe writer");
+    char chunk[PipeTestChunk / 3];
+    int total = 0, n;
+
+    printf("Streaming %d bytes through a pipe\n", PipeTestSize);
+    writer->Fork(PipeWriter, (int) pipe);
+    while ((n = pipe->Read(chunk, sizeof(chunk))) > 0) {
+	for (int j = 0; j < n; j++)
+	    if (chunk[j] != (char) ((total + j) % 251)) {
+		printf("Pipe test: wrong byte at %d\n", total + j);
+		n = -1;
+		break;
+	    }
+	if (n < 0)
+	    break;
+	total += n;
+	currentThread->Yield();
+    }
+    pipe->CloseReader();
+    printf("Pipe test: read %d bytes%s\n", total,
+	   (total == PipeTestSize) ? ", ok" : ", FAILED");
+    if (total == PipeTestSize)
+	delete pipe;			// else the writer may still be in it
 }
-void Test2(){
-    char data[SectorSize+1];
-    int length = fileSystem->ReadPipe(data);
-    data[length]=0;
-    printf("%s\n",data);
+
+//----------------------------------------------------------------------
+// DirectoryTest
+// 	Have several threads create, write and open files in one
+//	directory at the same time, giving up the CPU in the middle of
+//	each step, so that their Creates race each other and the Opens of
+//	files another thread is still creating or writing.  Once they are
+//	all done, check that every file is in the directory with what its
+//	thread wrote, and remove them all.
+//----------------------------------------------------------------------
+
+#define DirTestName	"DirTest"
+#define DirTestThreads	3
+#define DirTestFiles	4		// per thread; together more than a
+					// new directory has room for
+#define DirTestSize	(3 * SectorSize)
+
+static Semaphore *dirTestDone;
+
+static void
+DirTestFileName(char *name, int thread, int file)
+{
+    sprintf(name, "%s/f%d.%d", DirTestName, thread, file);
+}
+
+static void
+DirTestWorker(int which)
+{
+    OpenFile *openFile;
+    char name[32], chunk[SectorSize];
+    int i, j;
+
+    for (i = 0; i < DirTestFiles; i++) {
+	DirTestFileName(name, which, i);
+	if (!fileSystem->Create(name, 0)
+		|| (openFile = fileSystem->Open(name)) == NULL) {
+	    printf("Directory test: can't create %s\n", name);
+	    continue;
+	}
+	for (j = 0; j < DirTestSize; j += SectorSize) {
+	    for (int k = 0; k < SectorSize; k++)
+		chunk[k] = (char) ((which + i + j + k) % 251);
+	    if (openFile->Write(chunk, SectorSize) != SectorSize)
+		printf("Directory test: can't write %s\n", name);
+	    currentThread->Yield();
+	}
+	delete openFile;
+
+	// whatever the next thread has of its files so far
+	DirTestFileName(name, (which + 1) % DirTestThreads, i);
+	if ((openFile = fileSystem->Open(name)) != NULL) {
+	    currentThread->Yield();
+	    delete openFile;
+	}
+    }
+    dirTestDone->V();
+}
+
+void
+DirectoryTest()
+{
+    OpenFile *openFile;
+    char name[32], chunk[SectorSize];
+    int which, i, j, k;
+    bool ok = TRUE;
+
+    printf("%d threads creating %d files each in one directory\n",
+	   DirTestThreads, DirTestFiles);
+    if (!fileSystem->Create(DirTestName, -1)) {
+	printf("Directory test: can't create %s\n", DirTestName);
+	return;
+    }
+    dirTestDone = new Semaphore("directory test", 0);
+    for (which = 0; which < DirTestThreads; which++) {
+	sprintf(name, "dir test %d", which);
+	Thread *t = new Thread(strdup(name));
+	t->Fork(DirTestWorker, which);
+    }
+    for (which = 0; which < DirTestThreads; which++)
+	dirTestDone->P();
+    delete dirTestDone;
+
+    for (which = 0; which < DirTestThreads; which++)
+	for (i = 0; i < DirTestFiles; i++) {
+	    DirTestFileName(name, which, i);
+	    if ((openFile = fileSystem->Open(name)) == NULL) {
+		printf("Directory test: %s is missing\n", name);
+		ok = FALSE;
+		continue;
+	    }
+	    for (j = 0; ok && j < DirTestSize; j += SectorSize) {
+		if (openFile->Read(chunk, SectorSize) != SectorSize) {
+		    printf("Directory test: can't read %s\n", name);
+		    ok = FALSE;
+		}
+		for (k = 0; ok && k < SectorSize; k++)
+		    if (chunk[k] != (char) ((which + i + j + k) % 251)) {
+			printf("Directory test: wrong byte at %d in %s\n",
+			       j + k, name);
+			ok = FALSE;
+		    }
+	    }
+	    delete openFile;
+	    fileSystem->Remove(name);
+	}
+    fileSystem->Remove(DirTestName);
+    printf("Directory test: %s\n", ok ? "ok" : "FAILED");
+}
+
+//----------------------------------------------------------------------
+// JournalTest
+// 	Check that the sectors of a removed file are not reused before
+//	the removal has committed.  Run it twice.
+//
+//	The first run creates an empty file "JournalTest.new" and then a
+//	file "JournalTest" with a pattern in it, right behind it on disk,
+//	and commits both.  It removes "JournalTest" and writes as much
+//	into "JournalTest.new" -- which would be put in the sectors just
+//	freed, if they were free -- and halts before the removal commits,
+//	as if Nachos had crashed.  The data is written home at halt; the
+//	metadata is not.
+//
+//	The second run finds "JournalTest" again, replayed from the
+//	journal, and checks that its pattern is still there.
+//----------------------------------------------------------------------
+
+#define JournalTestName	"JournalTest"
+#define JournalTestNew	"JournalTest.new"
+#define JournalTestSize	(4 * SectorSize)
+
+void
+JournalTest()
+{
+    OpenFile *openFile;
+    char data[JournalTestSize];
+    int i;
+    bool ok;
+
+    if ((openFile = fileSystem->Open(JournalTestName)) != NULL) {
+	ok = (openFile->ReadAt(data, JournalTestSize, 0) == JournalTestSize);
+	for (i = 0; ok && i < JournalTestSize; i++)
+	    ok = (data[i] == (char) (i % 251));
+	delete openFile;
+	fileSystem->Remove(JournalTestName);
+	fileSystem->Remove(JournalTestNew);
+	printf("Journal test: removed file %s\n",
+	       ok ? "came back intact, ok" : "was overwritten, FAILED");
+	return;
+    }
+
+    for (i = 0; i < JournalTestSize; i++)
+	data[i] = (char) (i % 251);
+    if (!fileSystem->Create(JournalTestNew, 0)
+	    || !fileSystem->Create(JournalTestName, 0)
+	    || (openFile = fileSystem->Open(JournalTestName)) == NULL) {
+	printf("Journal test: can't create %s\n", JournalTestName);
+	return;
+    }
+    ok = (openFile->WriteAt(data, JournalTestSize, 0) == JournalTestSize);
+    delete openFile;
+    journal->Sync();			// both files are on disk for good
+    if (!ok || !fileSystem->Remove(JournalTestName)
+	    || (openFile = fileSystem->Open(JournalTestNew)) == NULL) {
+	printf("Journal test: can't set up\n");
+	return;
+    }
+    bzero(data, JournalTestSize);
+    openFile->WriteAt(data, JournalTestSize, 0);
+    delete openFile;
+    printf("Journal test: halting before the removal commits; "
+	   "run the test again\n");
+    interrupt->Halt();
 }
@@ -0,0 +1,459 @@
+// journal.cc
+//	Routines to keep a write-ahead journal of file system metadata
+//	updates (cf. journal.h).
+//
+//	The journal's own sectors are always read and written around the
+//	buffer cache, so that a commit reaches the disk before any of the
+//	sectors it protects can.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// JournalThread
+// 	Body of the commit thread.  Need this to be a C routine, because
+//	Thread::Fork can't take a pointer to a member function.
+//----------------------------------------------------------------------
+
+static void
+JournalThread(int arg)
+{
+    Journal *log = (Journal *) arg;
+
+    log->CommitDaemon();
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize an empty running transaction, and start the thread
+//	that commits transactions.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    start = synchDisk->NumSectors() - JournalSectors;
+    ASSERT(start > DirectorySector);	// room for the file system
+    lock = new Lock("journal lock");
+    commitWanted = new Condition("commit wanted");
+    handlesDone = new Condition("handles done");
+    committed = new Condition("committed");
+    numLogged = 0;
+    freed = new BitMap(synchDisk->NumSectors());
+    numFreed = 0;
+    syncWanted = FALSE;
+    activeHandles = 0;
+    committing = FALSE;
+    exclusive = NULL;
+    sequence = 1;
+    head = 0;
+
+    Thread *t = new Thread("journal");
+    t->Fork(JournalThread, (int) this);
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	Nachos is halting.  Leave the journal as it is: the buffer cache
+//	writes home only what is committed, and whatever of that did not
+//	get there before is replayed from the log at the next mount.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    delete lock;
+    delete commitWanted;
+    delete handlesDone;
+    delete committed;
+    delete freed;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Mark the journal's sectors in use in the free map of a file
+//	system being formatted, and write an empty journal.
+//----------------------------------------------------------------------
+
+void
+Journal::Format(BitMap *freeMap)
+{
+    for (int i = start; i < synchDisk->NumSectors(); i++)
+	freeMap->Mark(i);
+    sequence = 1;
+    head = 0;
+    WriteSuperblock();
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Copy every complete transaction in the journal, oldest first, to
+//	its home sectors.  A transaction counts only if its descriptor
+//	and its commit block both carry the next sequence #; the first
+//	one that doesn't ends the log (it was never committed, or it is
+//	left over from before the last checkpoint).
+//
+//	Then write everything home, and start with an empty journal.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    int super[SectorSize / sizeof(int)];
+    int descriptor[SectorSize / sizeof(int)];
+    int *commit;
+    char *data;
+    int pos = 0, n, replayed = 0;
+
+    synchDisk->ReadUncached(start, 1, (char *) super);
+    if (super[0] != JournalMagic) {
+	printf("No journal found, disk needs to be formatted (-f)\n");
+	return;
+    }
+    sequence = super[1];
+    while (pos + 2 <= JournalLogSectors) {
+	synchDisk->ReadUncached(start + 1 + pos, 1, (char *) descriptor);
+	n = descriptor[2];
+	if (descriptor[0] != JournalMagic || descriptor[1] != sequence
+		|| n < 1 || n > MaxTransactionSectors
+		|| pos + n + 2 > JournalLogSectors)
+	    break;
+	data = new char[(n + 1) * SectorSize];
+	synchDisk->ReadUncached(start + 2 + pos, n + 1, data);
+	commit = (int *) &data[n * SectorSize];
+	if (commit[0] != JournalCommitMagic || commit[1] != sequence) {
+	    delete [] data;
+	    break;
+	}
+	for (int i = 0; i < n; i++)
+	    synchDisk->WriteSector(descriptor[3 + i], &data[i * SectorSize]);
+	delete [] data;
+	DEBUG('j', "Replayed transaction %d, %d sectors\n", sequence, n);
+	pos += n + 2;
+	sequence++;
+	replayed++;
+    }
+    if (replayed > 0)
+	printf("Journal: replayed %d transactions\n", replayed);
+    Checkpoint();
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a metadata update by the current thread.  If a commit is
+//	in progress, or the running transaction is already big enough to
+//	be committed, wait for the commit first.  A thread that already
+//	holds a handle just nests, so that an update can call another.
+//
+//	Every open handle may still add MaxHandleSectors sectors to the
+//	transaction, so if there is no room for that many more, wait for
+//	the open handles to end.  Once they have, there always is.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    lock->Acquire();
+    if (currentThread->journalDepth == 0) {
+	for (;;) {
+	    if (committing || exclusive != NULL
+			   || numLogged >= CommitThreshold) {
+		commitWanted->Signal(lock);
+		committed->Wait(lock);
+	    } else if (numLogged + (activeHandles + 1) * MaxHandleSectors
+						> MaxTransactionSectors)
+		handlesDone->Wait(lock);
+	    else
+		break;
+	}
+	activeHandles++;
+    }
+    currentThread->journalDepth++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::BeginExclusive
+// 	Start an update that no other may overlap, such as repairing the
+//	free map: once the handles already open have ended, no one else
+//	gets one until the matching End.  The caller must not hold a
+//	handle already, nor any lock that an update might want.
+//----------------------------------------------------------------------
+
+void
+Journal::BeginExclusive()
+{
+    lock->Acquire();
+    ASSERT(currentThread->journalDepth == 0);
+    while (committing || exclusive != NULL)
+	committed->Wait(lock);
+    exclusive = currentThread;		// no new handles from now on
+    while (activeHandles > 0)
+	handlesDone->Wait(lock);
+    activeHandles++;
+    currentThread->journalDepth++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	The current thread's metadata update is complete.  If it was the
+//	last one open and the transaction is big enough, commit it.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    lock->Acquire();
+    ASSERT(currentThread->journalDepth > 0);
+    if (--currentThread->journalDepth == 0) {
+	activeHandles--;
+	if (exclusive == currentThread) {
+	    exclusive = NULL;
+	    committed->Broadcast(lock);	// let the others in again
+	}
+	if (activeHandles == 0) {
+	    handlesDone->Broadcast(lock);	// the commit thread, and maybe
+					// someone in BeginExclusive
+	    if (numLogged >= CommitThreshold)
+		commitWanted->Signal(lock);
+	}
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Log
+// 	"sector" is being written through SynchDisk.  If the current
+//	thread holds a handle, the sector is metadata: add it to the
+//	running transaction (once), and return TRUE so that it is pinned
+//	in the cache until the commit.
+//
+//	An update that writes more than MaxHandleSectors sectors may find
+//	the transaction full, and is not protected past that point.  The
+//	updates of the file system are kept below that on disks of a few
+//	thousand sectors (cf. OpenFile::WriteAt), but Check repairing a
+//	badly damaged one may not be, so say so.
+//----------------------------------------------------------------------
+
+bool
+Journal::Log(int sector)
+{
+    bool pin = TRUE;
+    int i;
+
+    if (currentThread->journalDepth == 0)
+	return FALSE;			// file data, not metadata
+    lock->Acquire();
+    for (i = 0; i < numLogged; i++)
+	if (logged[i] == sector)
+	    break;
+    if (i == numLogged) {
+	if (numLogged < MaxTransactionSectors) {
+	    logged[numLogged++] = sector;
+	    stats->numJournalSectors++;
+	} else {
+	    printf("Journal: transaction full, sector %d not journaled\n",
+		   sector);
+	    pin = FALSE;
+	}
+    }
+    lock->Release();
+    return pin;
+}
+
+//----------------------------------------------------------------------
+// Journal::Free
+// 	The current update no longer needs "sector".  Leave it marked in
+//	the free map until the running transaction, which the update is
+//	part of, has committed: before that, a crash would bring back what
+//	used it.
+//----------------------------------------------------------------------
+
+void
+Journal::Free(int sector)
+{
+    ASSERT(currentThread->journalDepth > 0);
+    lock->Acquire();
+    ASSERT(!freed->Test(sector));	// freed twice!
+    freed->Mark(sector);
+    numFreed++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Freeing
+// 	Return TRUE if "sector" has been freed by the running transaction,
+//	and so is still marked in the free map although nothing uses it.
+//----------------------------------------------------------------------
+
+bool
+Journal::Freeing(int sector)
+{
+    bool result;
+
+    lock->Acquire();
+    result = freed->Test(sector);
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// Journal::Sync
+// 	Commit the running transaction now, even if it is small, and wait
+//	until it is on disk.  The caller must not hold a handle.
+//----------------------------------------------------------------------
+
+void
+Journal::Sync()
+{
+    int running;
+
+    lock->Acquire();
+    ASSERT(currentThread->journalDepth == 0);
+    if (numLogged > 0) {
+	running = sequence;
+	syncWanted = TRUE;
+	commitWanted->Signal(lock);
+	while (sequence == running)
+	    committed->Wait(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::CommitDaemon
+// 	Loop forever: wait until a transaction is worth committing, keep
+//	new handles out, wait for the open ones to end, commit, and
+//	checkpoint if the journal is getting full.  Then give back the
+//	sectors the transaction freed.
+//----------------------------------------------------------------------
+
+void
+Journal::CommitDaemon()
+{
+    lock->Acquire();
+    for (;;) {
+	while (numLogged < CommitThreshold && !syncWanted)
+	    commitWanted->Wait(lock);
+	committing = TRUE;
+	while (activeHandles > 0)
+	    handlesDone->Wait(lock);
+	syncWanted = FALSE;
+	Commit();
+	if (head + MaxRecordSectors > JournalLogSectors)
+	    Checkpoint();
+	FreeCommitted();
+	committing = FALSE;
+	committed->Broadcast(lock);
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the running transaction to the journal: the descriptor, a
+//	copy of each sector, and the commit block, as one request.  Once
+//	that is on disk, the sectors may go home, so unpin them.
+//
+//	Called with the lock held, and no handles open.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    int n = numLogged;
+    char *record;
+    int *descriptor, *commit;
+
+    if (n == 0)
+	return;
+    record = new char[(n + 2) * SectorSize];
+    bzero(record, (n + 2) * SectorSize);
+    descriptor = (int *) record;
+    descriptor[0] = JournalMagic;
+    descriptor[1] = sequence;
+    descriptor[2] = n;
+    for (int i = 0; i < n; i++) {
+	descriptor[3 + i] = logged[i];
+	synchDisk->ReadSector(logged[i], &record[(i + 1) * SectorSize]);
+    }
+    commit = (int *) &record[(n + 1) * SectorSize];
+    commit[0] = JournalCommitMagic;
+    commit[1] = sequence;
+
+    DEBUG('j', "Committing transaction %d, %d sectors at %d\n", sequence,
+	  n, head);
+    synchDisk->WriteUncached(start + 1 + head, n + 2, record);
+    for (int i = 0; i < n; i++)
+	synchDisk->Unpin(logged[i]);
+    head += n + 2;
+    sequence++;
+    numLogged = 0;
+    stats->numJournalCommits++;
+    delete [] record;
+}
+
+//----------------------------------------------------------------------
+// Journal::FreeCommitted
+// 	The transaction that freed the sectors in "freed" has committed:
+//	clear them in the free map.  The free map sectors that changes go
+//	in the next transaction, as if the commit thread held a handle;
+//	new handles are still kept out.  A crash before that commits
+//	leaves the sectors marked but unused, which Check can repair.
+//
+//	Called with the lock held, and no handles open.
+//----------------------------------------------------------------------
+
+void
+Journal::FreeCommitted()
+{
+    BitMap *freeMap;
+
+    if (numFreed == 0)
+	return;
+    lock->Release();			// Log needs it
+    currentThread->journalDepth++;
+    freeMap = fileSystem->AcquireFreeMap();
+    for (int i = 0; i < synchDisk->NumSectors(); i++)
+	if (freed->Test(i)) {
+	    freeMap->Clear(i);
+	    freed->Clear(i);
+	}
+    fileSystem->ReleaseFreeMap();
+    currentThread->journalDepth--;
+    lock->Acquire();
+    DEBUG('j', "Freed %d sectors after the commit\n", numFreed);
+    numFreed = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write every dirty sector home, so that nothing in the journal is
+//	needed any more, and start the journal over.  Nothing may be
+//	pinned: there is no running transaction with sectors in it.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    DEBUG('j', "Checkpoint, next transaction %d\n", sequence);
+    synchDisk->Sync();
+    head = 0;
+    WriteSuperblock();
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteSuperblock
+// 	Record that the log starts at its beginning, with transaction
+//	"sequence".
+//----------------------------------------------------------------------
+
+void
+Journal::WriteSuperblock()
+{
+    int block[SectorSize / sizeof(int)];
+
+    bzero((char *) block, sizeof(block));
+    block[0] = JournalMagic;
+    block[1] = sequence;
+    synchDisk->WriteUncached(start, 1, (char *) block);
+}
@@ -0,0 +1,137 @@
+// journal.h
+//	Data structures for a write-ahead journal of file system metadata.
+//
+//	File system operations that change metadata (Create, Remove, and
+//	growing a file) run inside a "handle", between Journal::Begin and
+//	Journal::End.  Every sector written through SynchDisk while a
+//	thread holds a handle -- file headers, index blocks, directories,
+//	the free map -- joins the running transaction, and is pinned in
+//	the buffer cache, so that it cannot reach its home sector before
+//	the transaction is on disk in the journal.
+//
+//	The handles of many operations share one transaction ("group
+//	commit").  Once it has collected enough sectors, a kernel thread
+//	waits for the open handles to end, and writes the whole
+//	transaction into the journal as one sequential, multi-sector
+//	request:
+//
+//		descriptor: magic, sequence #, count, home sector of each
+//		the sectors themselves, one after the other
+//		commit block: commit magic, sequence #
+//
+//	After that the sectors are ordinary dirty buffers again, written
+//	home whenever the cache gets to it.
+//
+//	Sectors an update frees stay marked in the free map until its
+//	transaction has committed; until then, a crash would bring back
+//	the file they belong to, so nothing else may be written to them.
+//	The commit thread clears them in the free map as part of the next
+//	transaction.  When the journal is nearly
+//	full, the same thread checkpoints: it syncs the cache, so every
+//	committed change is home, and starts the journal over.
+//
+//	When the file system is mounted, every complete transaction in
+//	the journal is copied to its home sectors again ("replay"), so a
+//	crash leaves the metadata as it was after some transaction, never
+//	half way through one.
+//
+//	The journal takes the last JournalSectors sectors of the disk.
+//	The first is the journal superblock: magic, and the sequence # of
+//	the first transaction in the log.  The log follows it.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "synch.h"
+#include "bitmap.h"
+
+#define JournalSectors	128		// size of the journal on disk
+#define JournalLogSectors (JournalSectors - 1)
+					// all but the superblock
+#define JournalMagic	0x4a524e4c	// superblock and descriptors
+#define JournalCommitMagic 0x434d4954	// commit blocks
+
+#define MaxTransactionSectors (SectorSize / sizeof(int) - 3)
+					// home sectors that fit in a
+					// descriptor, after magic, sequence
+					// and count
+#define CommitThreshold	16		// commit once a transaction has
+					// this many sectors
+#define MaxHandleSectors (MaxTransactionSectors - CommitThreshold)
+					// most sectors one handle may add;
+					// a handle only starts if the open
+					// ones, and it, can each add that
+					// many without filling the
+					// transaction
+#define MaxRecordSectors (MaxTransactionSectors + 2)
+					// journal space one commit may need
+
+class Journal {
+  public:
+    Journal();				// start the commit thread; the
+					// journal itself is set up by
+					// Format or Recover
+    ~Journal();				// leave the committed transactions
+					// to be replayed at the next mount
+
+    void Format(BitMap *freeMap);	// reserve the journal's sectors in
+					// a new file system, and make it
+					// empty
+    void Recover();			// replay the committed transactions
+					// left in the journal, at mount
+
+    void Begin();			// start a metadata update; may wait
+					// for a commit.  Handles nest.
+    void BeginExclusive();		// start an update that must be the
+					// only one: wait for the open ones,
+					// and keep new ones out until End
+    void End();				// the update is complete
+    bool Log(int sector);		// called for every sector written
+					// through SynchDisk; TRUE if it
+					// joined the running transaction,
+					// and so must be pinned
+    void Free(int sector);		// free "sector" once the running
+					// transaction has committed
+    bool Freeing(int sector);		// is "sector" waiting for that?
+    void Sync();			// commit the running transaction
+					// now, and wait until it is on disk
+
+    void CommitDaemon();		// body of the commit thread
+
+    int Start() { return start; }	// first sector of the journal
+
+  private:
+    int start;				// the last JournalSectors of the disk
+					// begin here
+    Lock *lock;				// protects everything below
+    Condition *commitWanted;		// wakes up the commit thread
+    Condition *handlesDone;		// signalled when activeHandles
+					// drops to 0
+    Condition *committed;		// broadcast after each commit
+    int logged[MaxTransactionSectors];	// sectors in the running
+					// transaction
+    int numLogged;
+    BitMap *freed;			// sectors to free once the running
+    int numFreed;			// transaction has committed
+    bool syncWanted;			// someone is waiting in Sync
+    int activeHandles;			// threads inside Begin/End
+    bool committing;			// new handles must wait
+    Thread *exclusive;			// holder of an exclusive handle, or
+					// one waiting to hold it; new
+					// handles must wait
+    int sequence;			// sequence # of the running
+					// transaction
+    int head;				// where in the log the next
+					// transaction goes
+
+    void Commit();			// write the running transaction
+    void FreeCommitted();		// clear what it freed in the free
+					// map
+    void Checkpoint();			// get everything home, and empty
+					// the journal
+    void WriteSuperblock();
+};
+
+#endif // JOURNAL_H
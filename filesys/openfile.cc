@@ -5,7 +5,8 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  It is shared, through headerTable,
+//	with every other OpenFile for the same file.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,19 +23,22 @@
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it is already there
+//	because the file is open elsewhere.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = headerTable->Open(sector);
+    fileLock = headerTable->FileLock(sector);
     this->sector = sector;
-    synchDisk->numVisitors[sector]++;
     //hdr->Print();
     seekPosition = 0;
+    nextSector = 0;
+    readAheadWindow = 0;
+    readAheadLimit = 0;
 }
 
 //----------------------------------------------------------------------
@@ -44,8 +48,7 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    synchDisk->numVisitors[sector]--;
-    delete hdr;
+    headerTable->Close(sector);
 }
 
 //----------------------------------------------------------------------
@@ -78,23 +81,17 @@ OpenFile::Seek(int position)
 int
 OpenFile::Read(char *into, int numBytes)
 {
-    synchDisk->PlusReader(sector);
-    int result = ReadAt(into, numBytes, seekPosition);
-    currentThread->Yield();
-    seekPosition += result;
-    synchDisk->MinusReader(sector);
+   int result = ReadAt(into, numBytes, seekPosition);
+   seekPosition += result;
    return result;
 }
 
 int
 OpenFile::Write(char *into, int numBytes)
 {
-    synchDisk->BeginWrite(sector);
-    int result = WriteAt(into, numBytes, seekPosition);
-    currentThread->Yield();
-    seekPosition += result;
-    synchDisk->EndWrite(sector);
-    return result;
+   int result = WriteAt(into, numBytes, seekPosition);
+   seekPosition += result;
+   return result;
 }
 
 //----------------------------------------------------------------------
@@ -116,6 +113,24 @@ OpenFile::Write(char *into, int numBytes)
 //	   in the data that will be modified, and write back all the full
 //	   or partial sectors that are part of the request.
 //
+//	Holes in a sparse file (cf. filehdr.h) read as zeros, without
+//	touching the disk.  WriteAt gives the holes it writes into a disk
+//	sector first, and writing past the end of the file leaves a hole
+//	between the old end and "position".  If the disk fills up, only
+//	what could be given a sector is written.
+//
+//	ReadAt holds the file's lock shared, and WriteAt exclusive, so a
+//	read never sees half of a write, and two writes -- or a write and
+//	the growing of the file -- do not mix.  A WriteAt that may have to
+//	allocate opens its journal handle before it takes the lock, in
+//	keeping with the locking order (cf. filesys.cc).  It allocates
+//	WriteChunkSectors sectors at a time, each piece with its own
+//	handle and its own turn with the lock; a write that needs nothing
+//	allocated is done in one piece.
+//
+//	Only ReadAt drives read-ahead (cf. ReadAhead); the partial sectors
+//	WriteAt reads in first do not count as reading the file.
+//
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
 //	"numBytes" -- the number of bytes to transfer
@@ -125,10 +140,26 @@ OpenFile::Write(char *into, int numBytes)
 
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
+{
+    int result, end;
+
+    fileLock->Acquire_r();
+    end = min(position + numBytes, hdr->FileLength());
+    if (numBytes > 0 && position < end)	// what ReadAtLocked will read
+	ReadAhead(divRoundDown(position, SectorSize),
+		  divRoundDown(end - 1, SectorSize));
+    result = ReadAtLocked(into, numBytes, position);
+    fileLock->Release_r();
+    return result;
+}
+
+int
+OpenFile::ReadAtLocked(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int i, j, firstSector, lastSector, numSectors;
     char *buf;
+    int *sectors;
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
@@ -143,12 +174,22 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 
     // read in all the full and partial sectors that we need
     buf = new char[numSectors * SectorSize];
+    sectors = new int[numSectors];
     for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+        sectors[i - firstSector] = hdr->ByteToSector(i * SectorSize);
+    for (i = 0; i < numSectors; i = j) {	// runs of sectors, and holes
+	for (j = i + 1; j < numSectors && (sectors[j] == 0) == (sectors[i] == 0);
+									j++)
+	    ;
+	if (sectors[i] == 0)
+	    bzero(&buf[i * SectorSize], (j - i) * SectorSize);
+	else
+	    synchDisk->ReadSectors(&sectors[i], j - i, &buf[i * SectorSize]);
+    }
 
     // copy the part we want
     bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
+    delete [] sectors;
     delete [] buf;
     return numBytes;
 }
@@ -156,57 +197,151 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
-    int fileLength = hdr->FileLength();
-    //printf("numBytes:%d position:%d fileLength:%d\n",numBytes,position,fileLength);
+    int done, piece, written, first;
+
+    if ((position + numBytes) > MaxFileSize)
+	numBytes = MaxFileSize - position;
+    if ((numBytes <= 0) || (position < 0))
+	return 0;				// check request
+
+    for (done = 0; done < numBytes; done += written) {
+	piece = numBytes - done;
+	first = divRoundDown(position + done, SectorSize);
+	if ((position + numBytes) > hdr->FileLength()
+		|| hdr->HasHoles(first, divRoundDown(position + numBytes - 1,
+							SectorSize)))
+	    piece = min(piece, (first + WriteChunkSectors) * SectorSize
+							- (position + done));
+	written = WriteChunk(from + done, piece, position + done);
+	if (written < piece)
+	    return done + written;		// disk full
+    }
+    return done;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteChunk
+// 	Do the work of WriteAt for a piece of the request that allocates
+//	at most WriteChunkSectors sectors, under one journal handle, so
+//	that its metadata always fits in one transaction (cf. journal.h):
+//	the header, the index blocks of that many sectors, and the part
+//	of the free map they are in.
+//----------------------------------------------------------------------
+
+int
+OpenFile::WriteChunk(char *from, int numBytes, int position)
+{
+    bool allocating;
+    int fileLength, allocated;
     int i, firstSector, lastSector, numSectors;
     bool firstAligned, lastAligned;
     char *buf;
-    if((position + numBytes)>fileLength){
-        OpenFile *freeMapFile = new OpenFile(0);
-        BitMap *freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
-        hdr->Extend(freeMap,position+numBytes-fileLength);
-        hdr->WriteBack(sector);
-        freeMap->WriteBack(freeMapFile);
-        delete freeMapFile;
-    }
-    fileLength = hdr->FileLength();
-    //printf("\tnumBytes:%d position:%d fileLength:%d\n",numBytes,position,fileLength);
-
-    if ((numBytes <= 0) || (position >= fileLength))
-	return 0;				// check request
-    //if ((position + numBytes) > fileLength)
-	//numBytes = fileLength - position;
-    DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
-			numBytes, position, fileLength);
+    int *sectors;
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
 
+    // Holes are only ever filled, and files only grow, so if there is
+    // nothing to allocate now, there will not be once we have the lock.
+    allocating = (position + numBytes) > hdr->FileLength()
+			|| hdr->HasHoles(firstSector, lastSector);
+    if (allocating)
+        journal->Begin();		// header, index blocks and free map
+    fileLock->Acquire_w();
+    fileLength = hdr->FileLength();	// may have grown meanwhile
+    DEBUG('f', "Writing %d bytes at %d, to file of length %d.\n", 	
+			numBytes, position, fileLength);
+
     buf = new char[numSectors * SectorSize];
 
     firstAligned = (position == (firstSector * SectorSize));
     lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
 
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
+// read in first and last sector, if they are to be partially modified;
+// what is past the end of the file is zeros
+    if (!firstAligned) {
+	bzero(buf, SectorSize);
+        ReadAtLocked(buf, SectorSize, firstSector * SectorSize);	
+    }
+    if (!lastAligned && ((firstSector != lastSector) || firstAligned)) {
+	bzero(&buf[(lastSector - firstSector) * SectorSize], SectorSize);
+        ReadAtLocked(&buf[(lastSector - firstSector) * SectorSize], 
 				SectorSize, lastSector * SectorSize);	
+    }
+
+// give the holes we are writing into a sector, and grow the file
+    if (allocating) {
+        BitMap *freeMap = fileSystem->AcquireFreeMap();
+        allocated = hdr->AllocateRange(freeMap, firstSector, lastSector,
+				       sector);
+        fileSystem->ReleaseFreeMap();
+        if (allocated < numSectors) {	// disk full: write what fits
+            numBytes = max(0, (firstSector + allocated) * SectorSize
+							- position);
+            numSectors = allocated;
+        }
+        if (numBytes > 0)
+            hdr->SetLength(max(fileLength, position + numBytes));
+        hdr->WriteBack(sector);
+        journal->End();			// the data is not journaled
+    }
 
+    if (numBytes > 0) {
 // copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+	bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
 
 // write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+	sectors = new int[numSectors];
+	for (i = 0; i < numSectors; i++)	
+	    sectors[i] = hdr->ByteToSector((firstSector + i) * SectorSize);
+	synchDisk->WriteSectors(sectors, numSectors, buf);
+	delete [] sectors;
+    }
+    fileLock->Release_w();
     delete [] buf;
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called by ReadAt before it reads file sectors firstSector through
+//	lastSector.  If the read carries on from where the last one
+//	stopped (or re-reads its last sector), grow the read-ahead window;
+//	otherwise shrink it.  Then ask for the sectors in the window past
+//	lastSector that have not been asked for yet; they are read in the
+//	background while we, and the caller, keep going.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int firstSector, int lastSector)
+{
+    int numSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int last;
+
+    if (firstSector == nextSector || firstSector == nextSector - 1) {
+	if (readAheadWindow == 0)
+	    readAheadWindow = ReadAheadMin;
+	else
+	    readAheadWindow = min(2 * readAheadWindow, ReadAheadMax);
+    } else {
+	readAheadWindow /= 2;
+	readAheadLimit = 0;		// start over wherever we are now
+    }
+    nextSector = lastSector + 1;
+    if (readAheadWindow < ReadAheadMin)
+	return;
+
+    last = min(lastSector + readAheadWindow, numSectors - 1);
+    for (int i = max(readAheadLimit, lastSector + 1); i <= last; i++) {
+	int diskSector = hdr->ByteToSector(i * SectorSize);
+
+	if (diskSector != 0)		// nothing to read in a hole
+	    synchDisk->ReadAhead(diskSector);
+    }
+    readAheadLimit = max(readAheadLimit, last + 1);
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -9,9 +9,9 @@
 //
 //	The other is the "real" implementation, that turns these
 //	operations into read and write disk sector requests. 
-//	In this baseline implementation of the file system, we don't 
-//	worry about concurrent accesses to the file system
-//	by different threads -- this is part of the assignment.
+//	Concurrent accesses to a file by different threads are
+//	serialized by a reader/writer lock per file: any number of
+//	ReadAts at once, or one WriteAt.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -60,6 +60,17 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class RWLock;
+
+// Read-ahead window, in sectors.  It starts at ReadAheadMin once reads
+// look sequential, doubles with every further sequential read up to
+// ReadAheadMax, and is halved by every read that is not sequential.
+#define ReadAheadMin	2
+#define ReadAheadMax	16
+
+// Most sectors one journal handle of WriteAt allocates: one index
+// block's worth.
+#define WriteChunkSectors PointersPerSector
 
 class OpenFile {
   public:
@@ -90,6 +101,23 @@ class OpenFile {
     int sector;
   private:
     int seekPosition;			// Current position within the file
+    RWLock *fileLock;			// shared with every OpenFile for
+					// this file (cf. HeaderTable)
+
+    int ReadAtLocked(char *into, int numBytes, int position);
+					// ReadAt, with fileLock held
+    int WriteChunk(char *from, int numBytes, int position);
+					// WriteAt, for a piece that fits
+					// in one journal handle
+
+    int nextSector;			// file sector that would continue
+					// the last read sequentially
+    int readAheadWindow;		// sectors to read ahead, 0 if none
+    int readAheadLimit;			// sectors before this have been
+					// read ahead already
+    void ReadAhead(int firstSector, int lastSector);
+					// adapt the window to this read, and
+					// read ahead past it
 };
 
 #endif // FILESYS
@@ -0,0 +1,420 @@
+// pipe.cc
+//	Routines to pass bytes from one thread to another through a
+//	kernel pipe (cf. pipe.h), and to name the ends of pipes used by
+//	user programs.
+
+#include "copyright.h"
+#include "pipe.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// KernelPipe::KernelPipe
+// 	Initialize an empty pipe, with both ends open.
+//----------------------------------------------------------------------
+
+KernelPipe::KernelPipe()
+{
+    head = 0;
+    count = 0;
+    readerOpen = writerOpen = TRUE;
+    lock = new Lock("pipe lock");
+    dataReady = new Condition("pipe data ready");
+    spaceReady = new Condition("pipe space ready");
+#ifdef FILESYS
+    spill = NULL;
+    spillHead = spillTail = 0;
+#endif
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::~KernelPipe
+// 	De-allocate the pipe.  Its spill file is normally gone already;
+//	if Nachos is halting with the pipe still open, we only close it,
+//	since we cannot wait for the disk any more.
+//----------------------------------------------------------------------
+
+KernelPipe::~KernelPipe()
+{
+#ifdef FILESYS
+    delete spill;
+#endif
+    delete lock;
+    delete dataReady;
+    delete spaceReady;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Read
+// 	Take up to "numBytes" bytes out of the pipe, waiting until there
+//	is at least one, and return how many were taken.  Return 0 if the
+//	write end is closed and nothing is left.
+//
+//	"into" -- the buffer to put the bytes in
+//	"numBytes" -- the most bytes wanted
+//----------------------------------------------------------------------
+
+int
+KernelPipe::Read(char *into, int numBytes)
+{
+    int n, first;
+
+    lock->Acquire();
+#ifdef FILESYS
+    while (count == 0 && spillHead == spillTail && writerOpen)
+	dataReady->Wait(lock);
+    if (count == 0)
+	Refill();
+#else
+    while (count == 0 && writerOpen)
+	dataReady->Wait(lock);
+#endif
+    n = min(numBytes, count);
+    first = min(n, PipeBufferSize - head);	// up to the end of the ring
+    bcopy(&buffer[head], into, first);
+    bcopy(buffer, &into[first], n - first);
+    head = (head + n) % PipeBufferSize;
+    count -= n;
+    if (n > 0)
+	spaceReady->Broadcast(lock);
+    DEBUG('P', "Pipe read %d bytes, %d left in buffer\n", n, count);
+    lock->Release();
+    return n;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Write
+// 	Put "numBytes" bytes into the pipe, waiting for room as needed,
+//	and return how many went in: all of them, unless the read end is
+//	(or gets) closed.
+//
+//	Bytes go into the buffer while it has room.  With the real file
+//	system, the rest go to the spill file instead of waiting; once
+//	anything is there, everything after it must go there too, to stay
+//	in order.
+//
+//	"from" -- the bytes to write
+//	"numBytes" -- how many
+//----------------------------------------------------------------------
+
+int
+KernelPipe::Write(char *from, int numBytes)
+{
+    int done = 0;
+    int n, tail, first;
+
+    lock->Acquire();
+    while (done < numBytes && readerOpen) {
+	n = 0;
+#ifdef FILESYS
+	if (spillHead == spillTail)
+#endif
+	    n = min(numBytes - done, PipeBufferSize - count);
+	if (n > 0) {
+	    tail = (head + count) % PipeBufferSize;
+	    first = min(n, PipeBufferSize - tail);
+	    bcopy(&from[done], &buffer[tail], first);
+	    bcopy(&from[done + first], buffer, n - first);
+	    count += n;
+	}
+#ifdef FILESYS
+	else
+	    n = Spill(&from[done], numBytes - done);
+#endif
+	if (n == 0) {
+	    spaceReady->Wait(lock);		// full, even on disk
+	    continue;
+	}
+	done += n;
+	dataReady->Broadcast(lock);
+    }
+    DEBUG('P', "Pipe wrote %d of %d bytes\n", done, numBytes);
+    lock->Release();
+    return done;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::CloseReader/CloseWriter
+// 	Close one end of the pipe, and wake up whoever is waiting at the
+//	other end, so it can see.  Once both ends are closed, the spill
+//	file goes away.  Return FALSE if the end was closed already.
+//----------------------------------------------------------------------
+
+bool
+KernelPipe::CloseReader()
+{
+    bool wasOpen;
+
+    lock->Acquire();
+    wasOpen = readerOpen;
+    readerOpen = FALSE;
+    spaceReady->Broadcast(lock);
+#ifdef FILESYS
+    if (IsClosed())
+	DiscardSpill();
+#endif
+    lock->Release();
+    return wasOpen;
+}
+
+bool
+KernelPipe::CloseWriter()
+{
+    bool wasOpen;
+
+    lock->Acquire();
+    wasOpen = writerOpen;
+    writerOpen = FALSE;
+    dataReady->Broadcast(lock);
+#ifdef FILESYS
+    if (IsClosed())
+	DiscardSpill();
+#endif
+    lock->Release();
+    return wasOpen;
+}
+
+#ifdef FILESYS
+//----------------------------------------------------------------------
+// KernelPipe::Spill
+// 	Append up to "numBytes" bytes to the spill file, creating it the
+//	first time, and return how many were written; 0 if it is full.
+//	The caller holds the lock.
+//----------------------------------------------------------------------
+
+int
+KernelPipe::Spill(char *from, int numBytes)
+{
+    int n = min(numBytes, PipeSpillMax - spillTail);
+
+    if (n <= 0)
+	return 0;
+    if (spill == NULL) {
+	spill = fileSystem->CreateTemporary();
+	if (spill == NULL)
+	    return 0;				// no room on disk
+    }
+    n = spill->WriteAt(from, n, spillTail);
+    spillTail += n;
+    DEBUG('P', "Pipe spilled %d bytes, backlog %d\n", n,
+						spillTail - spillHead);
+    return n;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::Refill
+// 	The buffer is empty: move as much of the backlog as fits from the
+//	spill file into it.  Once the backlog is used up, the spill file
+//	is written from the beginning again.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+void
+KernelPipe::Refill()
+{
+    int n = min(spillTail - spillHead, PipeBufferSize);
+
+    ASSERT(count == 0);
+    if (n == 0)
+	return;
+    head = 0;
+    count = spill->ReadAt(buffer, n, spillHead);
+    spillHead += count;
+    if (spillHead == spillTail)
+	spillHead = spillTail = 0;
+}
+
+//----------------------------------------------------------------------
+// KernelPipe::DiscardSpill
+// 	Both ends are closed: give the spill file's sectors back.  The
+//	caller holds the lock.
+//----------------------------------------------------------------------
+
+void
+KernelPipe::DiscardSpill()
+{
+    if (spill != NULL) {
+	fileSystem->RemoveTemporary(spill);
+	spill = NULL;
+    }
+    spillHead = spillTail = 0;
+}
+#endif // FILESYS
+
+//----------------------------------------------------------------------
+// PipeTable::PipeTable
+// 	Initialize a table with no pipes in it.
+//----------------------------------------------------------------------
+
+PipeTable::PipeTable()
+{
+    for (int i = 0; i < MaxPipes; i++) {
+	pipes[i] = NULL;
+	users[i] = 0;
+    }
+    lock = new Lock("pipe table lock");
+}
+
+//----------------------------------------------------------------------
+// PipeTable::~PipeTable
+// 	De-allocate the table, and every pipe still open.
+//----------------------------------------------------------------------
+
+PipeTable::~PipeTable()
+{
+    for (int i = 0; i < MaxPipes; i++)
+	delete pipes[i];
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Create
+// 	Make a new pipe, and return the OpenFileIds of its ends in
+//	"readId" and "writeId".  Return FALSE if MaxPipes are open already.
+//----------------------------------------------------------------------
+
+bool
+PipeTable::Create(int *readId, int *writeId)
+{
+    int i;
+
+    lock->Acquire();
+    for (i = 0; i < MaxPipes; i++)
+	if (pipes[i] == NULL)
+	    break;
+    if (i < MaxPipes)
+	pipes[i] = new KernelPipe();
+    lock->Release();
+    if (i == MaxPipes)
+	return FALSE;
+    *readId = -(2 * i + 1);
+    *writeId = -(2 * i + 2);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Find
+// 	Return the pipe that OpenFileId "id" is an end of, or NULL if
+//	there is none, or both its ends are closed, and set "writeEnd" to
+//	say which end it is.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+KernelPipe *
+PipeTable::Find(int id, bool *writeEnd)
+{
+    int i = (-id - 1) / 2;
+
+    if (!IsPipe(id) || i >= MaxPipes || pipes[i] == NULL
+					|| pipes[i]->IsClosed())
+	return NULL;
+    *writeEnd = ((-id - 1) % 2 == 1);
+    return pipes[i];
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Enter/Leave
+// 	Count a thread going into, or coming out of, the pipe "id" is an
+//	end of, so that Close does not delete it from under the thread.
+//	The last one out of a pipe whose ends are both closed deletes it.
+//	The caller holds the lock.
+//----------------------------------------------------------------------
+
+void
+PipeTable::Enter(int id)
+{
+    users[(-id - 1) / 2]++;
+}
+
+void
+PipeTable::Leave(int id)
+{
+    int i = (-id - 1) / 2;
+
+    ASSERT(users[i] > 0);
+    if (--users[i] == 0 && pipes[i]->IsClosed()) {
+	delete pipes[i];
+	pipes[i] = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Read/Write
+// 	Read from, or write to, the pipe end named by "id", waiting as
+//	KernelPipe::Read/Write do.  Return -1 if "id" is not an end of the
+//	right kind.  The table lock is not held while we wait, but we are
+//	counted as inside the pipe, so it stays.
+//----------------------------------------------------------------------
+
+int
+PipeTable::Read(int id, char *into, int numBytes)
+{
+    KernelPipe *pipe;
+    bool writeEnd;
+    int result;
+
+    lock->Acquire();
+    pipe = Find(id, &writeEnd);
+    if (pipe == NULL || writeEnd) {
+	lock->Release();
+	return -1;
+    }
+    Enter(id);
+    lock->Release();
+
+    result = pipe->Read(into, numBytes);
+
+    lock->Acquire();
+    Leave(id);
+    lock->Release();
+    return result;
+}
+
+int
+PipeTable::Write(int id, char *from, int numBytes)
+{
+    KernelPipe *pipe;
+    bool writeEnd;
+    int result;
+
+    lock->Acquire();
+    pipe = Find(id, &writeEnd);
+    if (pipe == NULL || !writeEnd) {
+	lock->Release();
+	return -1;
+    }
+    Enter(id);
+    lock->Release();
+
+    result = pipe->Write(from, numBytes);
+
+    lock->Acquire();
+    Leave(id);
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// PipeTable::Close
+// 	Close the pipe end named by "id"; once both of its ends are
+//	closed, and no one is still inside it, the pipe goes away.
+//	Return FALSE if "id" is not open.
+//----------------------------------------------------------------------
+
+bool
+PipeTable::Close(int id)
+{
+    KernelPipe *pipe;
+    bool writeEnd, wasOpen;
+
+    lock->Acquire();
+    pipe = Find(id, &writeEnd);
+    if (pipe == NULL) {
+	lock->Release();
+	return FALSE;
+    }
+    wasOpen = writeEnd ? pipe->CloseWriter() : pipe->CloseReader();
+    if (pipe->IsClosed() && users[(-id - 1) / 2] == 0) {
+	pipes[(-id - 1) / 2] = NULL;
+	delete pipe;
+    }
+    lock->Release();
+    return wasOpen;
+}
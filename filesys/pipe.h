@@ -0,0 +1,110 @@
+// pipe.h
+//	Data structures for kernel pipes, which carry a stream of bytes
+//	from one thread (or user program) to another.
+//
+//	The bytes are held in a ring buffer in memory.  Read waits until
+//	there is something to read, or the write end is closed; Write
+//	waits until everything has been taken in, or the read end is
+//	closed.  So a writer and a reader that keep up with each other
+//	never touch the disk.
+//
+//	With the real file system, a writer that gets more than a buffer
+//	ahead of its reader does not wait: the backlog spills into a
+//	temporary file with no name, up to PipeSpillMax bytes, and comes
+//	back into the buffer a buffer full at a time as the reader
+//	catches up.  The file goes away when both ends are closed.
+//
+//	A pipe's lock is held while it reads or writes its spill file, so
+//	it comes before every file system lock (cf. filesys.cc); nothing
+//	in the file system uses pipes.
+//
+//	User programs get at pipes through the Pipe system call.  Their
+//	ends are named by negative OpenFileIds, through the PipeTable, so
+//	that Read, Write and Close can tell them from open files.
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "synch.h"
+#include "openfile.h"
+
+#define PipeBufferSize	1024		// bytes held in memory
+#define PipeSpillMax	(32 * 1024)	// most bytes in the spill file
+#define MaxPipes	16		// pipes open at once, system wide
+
+// The following class defines one pipe.
+class KernelPipe {
+  public:
+    KernelPipe();			// an empty pipe, both ends open
+    ~KernelPipe();
+
+    int Read(char *into, int numBytes);	// take up to numBytes out, waiting
+					// for at least one; 0 once the
+					// write end is closed and the pipe
+					// is empty
+    int Write(char *from, int numBytes);// put numBytes in, waiting for room;
+					// fewer if the read end is closed
+
+    bool CloseReader();			// close one end; FALSE if it was
+    bool CloseWriter();			// closed already
+    bool IsClosed() { return !readerOpen && !writerOpen; }
+
+  private:
+    char buffer[PipeBufferSize];	// the ring buffer
+    int head;				// oldest unread byte in buffer
+    int count;				// unread bytes in buffer
+    bool readerOpen, writerOpen;
+    Lock *lock;				// protects everything in the pipe
+    Condition *dataReady;		// signalled when bytes come in
+    Condition *spaceReady;		// signalled when bytes go out
+
+#ifdef FILESYS
+    OpenFile *spill;			// the backlog, NULL until needed
+    int spillHead;			// unread bytes of the spill file are
+    int spillTail;			// those from spillHead to spillTail
+
+    int Spill(char *from, int numBytes);// append to the spill file
+    void Refill();			// move the backlog into the buffer
+    void DiscardSpill();		// remove the spill file
+#endif
+};
+
+// The following class names the ends of the pipes that user programs
+// have open.  The read end of pipe i is OpenFileId -(2i + 1), and the
+// write end is -(2i + 2).
+//
+// An end may be closed while another thread is still reading or writing
+// the pipe: the table counts the threads inside each pipe, and a pipe
+// with both ends closed only goes away once the last of them is out.
+class PipeTable {
+  public:
+    PipeTable();
+    ~PipeTable();			// Nachos is halting; any spill
+					// files still in use are lost
+
+    static bool IsPipe(int id) { return id < 0; }
+
+    bool Create(int *readId, int *writeId);
+					// a new pipe; FALSE if too many
+    int Read(int id, char *into, int numBytes);
+    int Write(int id, char *from, int numBytes);
+					// as KernelPipe::Read/Write; -1 if "id"
+					// is not an open end of that kind
+    bool Close(int id);			// FALSE if "id" is not open
+
+  private:
+    KernelPipe *pipes[MaxPipes];	// NULL if the slot is free
+    int users[MaxPipes];		// threads reading or writing each
+    Lock *lock;				// protects pipes[] and users[]
+
+    KernelPipe *Find(int id, bool *writeEnd);
+					// the pipe "id" belongs to
+    void Enter(int id);			// one more thread inside a pipe
+    void Leave(int id);			// one less; delete the pipe if it
+					// was the last, and both ends are
+					// closed
+};
+
+#endif // PIPE_H
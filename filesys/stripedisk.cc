@@ -0,0 +1,258 @@
+// stripedisk.cc
+//	Routines to spread disk requests over the member disks of a
+//	striped volume (cf. stripedisk.h), and to put the pieces back
+//	together when they are done.
+//
+//	Each member's part of a request has to go to its disk as one
+//	buffer.  If the part is a single stripe unit, or there is only one
+//	member, it is already in one piece in the caller's buffer and is
+//	transferred straight from there; otherwise it is gathered into a
+//	copy before a write, and scattered back from it after a read.
+
+#include "copyright.h"
+#include "stripedisk.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// StripeMemberDone
+// 	Interrupt handler of a member disk.  Need this to be a C routine,
+//	because C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+StripeMemberDone(int arg)
+{
+    StripeMember *member = (StripeMember *) arg;
+
+    member->volume->MemberDone(member);
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::StripedDisk
+// 	Initialize a striped volume, in turn initializing each of its
+//	member disks.
+//
+//	"name" -- UNIX file name of the first member; the others are
+//	   "name" followed by their number (DISK, DISK1, DISK2, ...)
+//	"memberCount" -- how many disks to stripe over
+//	"unit" -- how many consecutive sectors go on each
+//	"memberGeometry" -- the size and speed of each member
+//	"callWhenDone" -- interrupt handler to be called when a request
+//	   completes on every member it needed
+//	"callArg" -- argument to pass the interrupt handler
+//----------------------------------------------------------------------
+
+StripedDisk::StripedDisk(char* name, int memberCount, int unit,
+			 DiskGeometry *memberGeometry,
+			 VoidFunctionPtr callWhenDone, int callArg)
+{
+    char memberName[64];
+
+    ASSERT(memberCount > 0 && unit > 0);
+    ASSERT(memberGeometry->NumSectors() % unit == 0);	// no part units
+    numMembers = memberCount;
+    stripeUnit = unit;
+    geometry = *memberGeometry;
+    geometry.sectorsPerTrack *= numMembers;
+    handler = callWhenDone;
+    handlerArg = callArg;
+    outstanding = 0;
+
+    members = new StripeMember[numMembers];
+    for (int i = 0; i < numMembers; i++) {
+	if (i == 0)
+	    strcpy(memberName, name);
+	else
+	    sprintf(memberName, "%s%d", name, i);
+	members[i].volume = this;
+	members[i].numSectors = 0;
+	members[i].disk = new Disk(memberName, memberGeometry, StripeMemberDone,
+							(int) &members[i]);
+    }
+    DEBUG('d', "Striping %d disks, %d sectors at a time\n",
+						numMembers, stripeUnit);
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::~StripedDisk
+// 	Deallocate the member disks.
+//----------------------------------------------------------------------
+
+StripedDisk::~StripedDisk()
+{
+    for (int i = 0; i < numMembers; i++)
+	delete members[i].disk;
+    delete [] members;
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::SectorOn
+// 	Return where logical sector "sector" is on its member disk: the
+//	units a member holds are packed one after the other.
+//----------------------------------------------------------------------
+
+int
+StripedDisk::SectorOn(int sector)
+{
+    int unit = sector / stripeUnit;
+
+    return (unit / numMembers) * stripeUnit + sector % stripeUnit;
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::ReadRequest/WriteRequest
+// 	Start reading/writing "numSectors" consecutive logical sectors,
+//	starting at "sectorNumber".  Each member that holds some of them
+//	gets one request for its part, all at once; the caller's handler
+//	is invoked when the last of them finishes.
+//
+//	"data" -- numSectors * SectorSize bytes, to write or to read into
+//----------------------------------------------------------------------
+
+void
+StripedDisk::ReadRequest(int sectorNumber, int numSectors, char* data)
+{
+    ASSERT(outstanding == 0);			// only one request at a time
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+	   && (sectorNumber + numSectors <= geometry.NumSectors()));
+
+    writing = FALSE;
+    Split(sectorNumber, numSectors, data);
+    for (int i = 0; i < numMembers; i++)
+	if (members[i].numSectors > 0)
+	    members[i].disk->ReadRequest(members[i].firstSector,
+				members[i].numSectors, members[i].buffer);
+}
+
+void
+StripedDisk::WriteRequest(int sectorNumber, int numSectors, char* data)
+{
+    ASSERT(outstanding == 0);
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+	   && (sectorNumber + numSectors <= geometry.NumSectors()));
+
+    writing = TRUE;
+    Split(sectorNumber, numSectors, data);
+    CopyParts(TRUE);
+    for (int i = 0; i < numMembers; i++)
+	if (members[i].numSectors > 0)
+	    members[i].disk->WriteRequest(members[i].firstSector,
+				members[i].numSectors, members[i].buffer);
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::Split
+// 	Work out which member disks the request for "numSectors" sectors
+//	from "sectorNumber" on needs, where its part is on each, and where
+//	its data is to go to or come from: straight from "data" if the
+//	part is in one piece there, else a copy.
+//----------------------------------------------------------------------
+
+void
+StripedDisk::Split(int sectorNumber, int numSectors, char* data)
+{
+    StripeMember *member;
+    int i;
+
+    requestSector = sectorNumber;
+    requestLength = numSectors;
+    requestData = data;
+    for (i = 0; i < numMembers; i++) {
+	members[i].numSectors = 0;
+	members[i].copied = FALSE;
+    }
+
+    for (i = sectorNumber; i < sectorNumber + numSectors; i++) {
+	member = &members[MemberOf(i)];
+	if (member->numSectors == 0) {
+	    member->firstSector = SectorOn(i);
+	    member->buffer = &data[(i - sectorNumber) * SectorSize];
+	} else if (MemberOf(i - 1) != MemberOf(i))
+	    member->copied = TRUE;		// back again: not in one piece
+	member->numSectors++;
+    }
+
+    outstanding = 0;
+    for (i = 0; i < numMembers; i++) {
+	if (members[i].copied)
+	    members[i].buffer = new char[members[i].numSectors * SectorSize];
+	if (members[i].numSectors > 0)
+	    outstanding++;
+    }
+    DEBUG('d', "Striped request for %d sectors at %d goes to %d disks\n",
+					numSectors, sectorNumber, outstanding);
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::CopyParts
+// 	Copy the sectors of the current request between the caller's
+//	buffer and the copies made for members whose part is not in one
+//	piece there: into the copies if "toMembers", else back out.
+//----------------------------------------------------------------------
+
+void
+StripedDisk::CopyParts(bool toMembers)
+{
+    for (int i = requestSector; i < requestSector + requestLength; i++) {
+	StripeMember *member = &members[MemberOf(i)];
+	char *mine, *theirs;
+
+	if (!member->copied)
+	    continue;
+	mine = &member->buffer[(SectorOn(i) - member->firstSector)
+								* SectorSize];
+	theirs = &requestData[(i - requestSector) * SectorSize];
+	if (toMembers)
+	    bcopy(theirs, mine, SectorSize);
+	else
+	    bcopy(mine, theirs, SectorSize);
+    }
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::MemberDone
+// 	A member disk has finished its part of the current request.  Once
+//	they all have, put the data read where the caller wants it, free
+//	the copies, and tell the caller.
+//----------------------------------------------------------------------
+
+void
+StripedDisk::MemberDone(StripeMember *member)
+{
+    ASSERT(outstanding > 0 && member->numSectors > 0);
+    if (--outstanding > 0)
+	return;
+
+    if (!writing)
+	CopyParts(FALSE);
+    for (int i = 0; i < numMembers; i++)
+	if (members[i].copied)
+	    delete [] members[i].buffer;
+    (*handler)(handlerArg);
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::WriteAtShutdown
+// 	Write a sector straight to the member disk it is on, when Nachos
+//	is halting (cf. Disk::WriteAtShutdown).
+//----------------------------------------------------------------------
+
+void
+StripedDisk::WriteAtShutdown(int sectorNumber, char* data)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < geometry.NumSectors()));
+    members[MemberOf(sectorNumber)].disk->WriteAtShutdown(
+					SectorOn(sectorNumber), data);
+}
+
+//----------------------------------------------------------------------
+// StripedDisk::Sync
+// 	Make sure every member's UNIX file holds what was written to it.
+//----------------------------------------------------------------------
+
+void
+StripedDisk::Sync()
+{
+    for (int i = 0; i < numMembers; i++)
+	members[i].disk->Sync();
+}
@@ -0,0 +1,104 @@
+// stripedisk.h
+//	Data structures for a block device made of several simulated disks,
+//	striped RAID-0 style, so that one request keeps all of them busy.
+//
+//	A physical disk does one request at a time, so a single disk moves
+//	at most one track's worth of sectors per rotation.  A StripedDisk
+//	deals its logical sectors out to its member disks "stripeUnit"
+//	sectors at a time: the first unit goes to member 0, the next to
+//	member 1, and so on, wrapping around to member 0 again.  The units
+//	a member gets are consecutive on it, so any run of consecutive
+//	logical sectors is at most one run on each member.
+//
+//	A request is split into those runs, and each is sent to its member
+//	at once; every member has its own interrupt, and the request is
+//	done when the last of them is.  A long transfer therefore takes
+//	about as long as its share on one member, and gets close to
+//	"numMembers" times faster than on a single disk.
+//
+//	To SynchDisk, a StripedDisk looks just like a Disk: one request at
+//	a time, with an interrupt when it completes.  Its geometry is that
+//	of one member, with tracks "numMembers" times as long.  With one
+//	member, requests go straight through to it.
+//
+//	The layout depends on the number of members and the stripe unit,
+//	so a volume has to be formatted with the same ones it is used with.
+
+#ifndef STRIPEDISK_H
+#define STRIPEDISK_H
+
+#include "copyright.h"
+#include "disk.h"
+
+class StripedDisk;
+
+// One member disk of a striped volume, and its part of the request
+// being done.
+class StripeMember {
+  public:
+    StripedDisk *volume;		// the volume it is part of
+    Disk *disk;				// the simulated disk itself
+    int firstSector;			// first sector of its part, on it
+    int numSectors;			// length of its part, 0 if none
+    char *buffer;			// its part of the data, or a copy
+					// of it if it is not in one piece
+    bool copied;			// "buffer" is a copy
+};
+
+// The following class defines a striped volume, with the same interface
+// as Disk.
+class StripedDisk {
+  public:
+    StripedDisk(char* name, int memberCount, int unit,
+		DiskGeometry *memberGeometry, VoidFunctionPtr callWhenDone,
+		int callArg);
+    					// Create a volume on "memberCount"
+					// disks shaped like "memberGeometry",
+					// "unit" sectors at a time, in
+					// UNIX files "name", "name"1, ...
+					// Invoke (*callWhenDone)(callArg)
+					// every time a request completes.
+    ~StripedDisk();			// Deallocate the member disks.
+
+    void ReadRequest(int sectorNumber, int numSectors, char* data);
+    void WriteRequest(int sectorNumber, int numSectors, char* data);
+    					// Read/write "numSectors" consecutive
+					// sectors, on all the members that
+					// hold some of them at once.
+					// Only one request allowed at a time!
+    void WriteAtShutdown(int sectorNumber, char* data);
+    					// Write a sector straight to its
+					// member's UNIX file (cf. Disk)
+    void Sync();			// Sync every member
+
+    void MemberDone(StripeMember *member);
+					// Interrupt handler, invoked when a
+					// member finishes its part
+
+    DiskGeometry *Geometry() { return &geometry; }
+
+  private:
+    StripeMember *members;		// the member disks
+    int numMembers;			// how many there are
+    int stripeUnit;			// consecutive sectors per member
+    DiskGeometry geometry;		// of the whole volume
+    VoidFunctionPtr handler;		// Interrupt handler, to be invoked
+					// when a whole request finishes
+    int handlerArg;			// Argument to interrupt handler
+    int requestSector;			// the request being done: its first
+    int requestLength;			// sector, how many there are, the
+    char *requestData;			// caller's buffer, and whether it
+    bool writing;			// is a write
+    int outstanding;			// members still working on it
+
+    int MemberOf(int sector) { return (sector / stripeUnit) % numMembers; }
+					// which member a sector is on
+    int SectorOn(int sector);		// and where, on that member
+    void Split(int sectorNumber, int numSectors, char* data);
+					// work out each member's part
+    void CopyParts(bool toMembers);	// gather the request's data into
+					// the members' copies, or scatter
+					// it back
+};
+
+#endif // STRIPEDISK_H
@@ -5,10 +5,12 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request carries its own semaphore, which the interrupt
+//	handler signals when that request is done.  Because the physical
+//	disk can only handle one operation at a time, other requests wait
+//	in a queue; the interrupt handler starts the next one, picked to
+//	keep the head moving in one direction.  The queue is only touched
+//	with interrupts disabled.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +18,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -37,20 +40,22 @@ DiskRequestDone (int arg)
 //	initializing the physical disk.
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
-//	   (usually, "DISK")
+//	   (usually, "DISK"); more disks are in "name"1, "name"2, ...
+//	"numMembers" -- how many disks the data is striped over
+//	"stripeUnit" -- how many consecutive sectors go on each
+//	"geometry" -- the size and speed of each disk
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, int numMembers, int stripeUnit,
+		     DiskGeometry *geometry)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, (int) this);
-    readerLock = new Lock("reader lock");
-    for(int i=0;i<NumSectors;++i){
-        numReaders[i]=0;
-        numVisitors[i]=0;
-        mutex[i]=new Semaphore("mutex",1);
-    }
+    pending = new List;
+    active = NULL;
+    headSector = 0;
+    idleWaiters = new List;
+    disk = new StripedDisk(name, numMembers, stripeUnit, geometry,
+			   DiskRequestDone, (int) this);
+    cache = new BufferCache(this);
 }
 
 //----------------------------------------------------------------------
@@ -61,15 +66,16 @@ SynchDisk::SynchDisk(char* name)
 
 SynchDisk::~SynchDisk()
 {
+    delete cache;			// writes back dirty sectors
     delete disk;
-    delete lock;
-    delete semaphore;
+    delete pending;
+    delete idleWaiters;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
-// 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+// 	Read the contents of a disk sector into a buffer, through the
+//	buffer cache.  Return only after the data has been read.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -78,16 +84,15 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    cache->Read(sectorNumber, data);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector, through the
+//	buffer cache.  The data may not be on disk until the next Sync.
+//	If the journal takes the sector into its running transaction,
+//	it is pinned in the cache until the transaction commits.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -96,48 +101,252 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    cache->Write(sectorNumber, data,
+		 journal != NULL && journal->Log(sectorNumber));
 }
 
 //----------------------------------------------------------------------
-// SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// SynchDisk::ReadSectors/WriteSectors
+// 	Read/write a list of sectors, through the buffer cache.  This is
+//	the same as calling ReadSector/WriteSector for each of them, except
+//	that runs of consecutive sectors that have to go to the disk are
+//	transferred in one request.
+//
+//	"sectors" -- the disk sectors to read/write, in order
+//	"numSectors" -- how many there are
+//	"data" -- numSectors * SectorSize bytes, one sector after the other
 //----------------------------------------------------------------------
 
 void
-SynchDisk::RequestDone()
-{ 
-    semaphore->V();
+SynchDisk::ReadSectors(int *sectors, int numSectors, char* data)
+{
+    cache->ReadSectors(sectors, numSectors, data);
+}
+
+void
+SynchDisk::WriteSectors(int *sectors, int numSectors, char* data)
+{
+    for (int i = 0; i < numSectors; i++)	// write-back: no disk I/O yet
+	WriteSector(sectors[i], &data[i * SectorSize]);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Write all dirty cached sectors to disk, and make sure the disk
+//	has them in its UNIX file.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    cache->Sync();
+    disk->Sync();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Unpin
+// 	The journal has committed "sectorNumber"; let the cache write it
+//	home.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Unpin(int sectorNumber)
+{
+    cache->Unpin(sectorNumber);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadAhead
+// 	Hint that "sectorNumber" will be read soon; it is read into the
+//	cache in the background.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadAhead(int sectorNumber)
+{
+    cache->ReadAhead(sectorNumber);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WaitUntilIdle
+// 	Wait until the disk has nothing to do.  The interrupt handler wakes
+//	us when the queue drains; if someone else's request got in first,
+//	wait again.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WaitUntilIdle()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (active != NULL) {
+	Semaphore idle("disk idle", 0);
+
+	idleWaiters->Append((void *) &idle);
+	idle.P();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadUncached
+// 	Read the contents of consecutive disk sectors into a buffer, from
+//	the disk itself.  Return only after the data has been read.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"numSectors" -- how many sectors to read
+//	"data" -- the buffer to hold the contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadUncached(int sectorNumber, int numSectors, char* data)
+{
+    Semaphore done("disk read", 0);
+    DiskRequest request;
+
+    request.sector = sectorNumber;
+    request.numSectors = numSectors;
+    request.data = data;
+    request.writing = FALSE;
+    request.done = &done;
+    Submit(&request);
 }
 
-void SynchDisk::PlusReader(int sector){
+//----------------------------------------------------------------------
+// SynchDisk::WriteUncached
+// 	Write the contents of a buffer into consecutive disk sectors, on
+//	the disk itself.  Return only after the data has been written.
+//
+//	"sectorNumber" -- the first disk sector to be written
+//	"numSectors" -- how many sectors to write
+//	"data" -- the new contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteUncached(int sectorNumber, int numSectors, char* data)
+{
+    Semaphore done("disk write", 0);
+    DiskRequest request;
 
-    readerLock->Acquire();
-    numReaders[sector]++;
-    if(numReaders[sector]==1){
-        mutex[sector]->P();
+    request.sector = sectorNumber;
+    request.numSectors = numSectors;
+    request.data = data;
+    request.writing = TRUE;
+    request.done = &done;
+    Submit(&request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Submit
+// 	Start a request right away if the disk is idle, otherwise queue
+//	it; either way, wait until the interrupt handler says it is done.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if (active == NULL)
+	Start(request);
+    else
+	pending->SortedInsert((void *) request, request->sector);
+    request->done->P();			// wait for interrupt
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Start
+// 	Send a request to the disk.  Interrupts must be disabled.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    active = request;
+    headSector = request->sector + request->numSectors - 1;
+    if (request->writing)
+	disk->WriteRequest(request->sector, request->numSectors, request->data);
+    else
+	disk->ReadRequest(request->sector, request->numSectors, request->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::NextRequest
+// 	Remove and return the pending request to serve next, or NULL if
+//	there are none.  Interrupts must be disabled.
+//
+//	C-LOOK: the first request at or after the head, else the lowest
+//	one.  With DISK_SSTF: the request on the nearest track.  Ties go
+//	to the request that has been waiting longest, as SortedInsert
+//	keeps equal keys in arrival order.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::NextRequest()
+{
+    ListElement *ptr;
+    DiskRequest *best = NULL;
+
+    if (pending->IsEmpty())
+	return NULL;
+#ifdef DISK_SSTF
+    int perTrack = disk->Geometry()->sectorsPerTrack;
+    int headTrack = headSector / perTrack;
+    int bestDistance = disk->Geometry()->numTracks;
+
+    for (ptr = pending->getfirst(); ptr != NULL; ptr = ptr->next) {
+	int distance = abs(ptr->key / perTrack - headTrack);
+
+	if (distance < bestDistance) {
+	    best = (DiskRequest *) ptr->item;
+	    bestDistance = distance;
+	}
     }
-    printf("reader cnt :%d\n",numReaders[sector]);
-    readerLock->Release();
-    printf("reader read:%d\n",sector);
-}
-void SynchDisk::MinusReader(int sector){
-    readerLock->Acquire();
-    numReaders[sector]--;
-    if(numReaders[sector]==0)
-        mutex[sector]->V();
-    printf("reader cnt :%d\n",numReaders[sector]);
-    readerLock->Release();
-}
-void SynchDisk::BeginWrite(int sector){
-    printf("write lock:%d\n",sector);
-    mutex[sector]->P();
-}
-void SynchDisk::EndWrite(int sector){
-    printf("write release:%d\n",sector);
-    mutex[sector]->V();
+#else
+    for (ptr = pending->getfirst(); ptr != NULL; ptr = ptr->next)
+	if (ptr->key >= headSector) {
+	    best = (DiskRequest *) ptr->item;
+	    break;
+	}
+    if (best == NULL)				// wrap around
+	best = (DiskRequest *) pending->getfirst()->item;
+#endif
+    pending->Remove((void *) best);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteAtShutdown
+// 	Write a sector without going through the disk's interrupt, when
+//	Nachos is halting and no thread may be left to wait for one.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteAtShutdown(int sectorNumber, char* data)
+{
+    disk->WriteAtShutdown(sectorNumber, data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::RequestDone
+// 	Disk interrupt handler.  Start the next queued request, if any, so
+//	the disk stays busy, and wake up the thread waiting for the one
+//	that just finished; if there is none, also wake up everyone
+//	waiting for the disk to go idle.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::RequestDone()
+{ 
+    DiskRequest *finished = active;
+    DiskRequest *next = NextRequest();
+
+    active = NULL;
+    if (next != NULL)
+	Start(next);
+    else
+	while (!idleWaiters->IsEmpty())
+	    ((Semaphore *) idleWaiters->Remove())->V();
+    finished->done->V();
 }
@@ -12,7 +12,22 @@
 #define SYNCHDISK_H
 
 #include "disk.h"
+#include "stripedisk.h"
 #include "synch.h"
+#include "bufcache.h"
+#include "list.h"
+
+// One read or write waiting for, or being served by, the disk.  It lives
+// on the stack of the thread that asked for it.
+class DiskRequest {
+  public:
+    int sector;				// first sector
+    int numSectors;			// how many consecutive sectors
+    char *data;				// where to read it into or write
+					// it from
+    bool writing;			// write rather than read
+    Semaphore *done;			// V'ed when the request completes
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -24,10 +39,29 @@
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// ReadSector and WriteSector go through a BufferCache, so a request may
+// be satisfied without touching the disk at all, and a write may only
+// reach the disk later; Sync forces it out.
+//
+// Many threads can have requests outstanding at once.  They are queued
+// in sector (and so track) order, and when the disk finishes one, the
+// next is chosen C-LOOK style: the first at or past the head position,
+// wrapping around to the lowest sector once there are none left ahead.
+// Compiling with -DDISK_SSTF picks the request closest to the head
+// instead, which seeks less but can starve requests at the edges.
+//
+// The "disk" may be several simulated disks striped together (cf.
+// stripedisk.h); it still does one request at a time, but a long one
+// is done by all of them at once.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    SynchDisk(char* name, int numMembers, int stripeUnit,
+	      DiskGeometry *geometry);
+    					// Initialize a synchronous disk,
+					// by initializing the raw disks:
+					// "numMembers" of them, striped
+					// "stripeUnit" sectors at a time
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -37,25 +71,51 @@ class SynchDisk {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+    void ReadSectors(int *sectors, int numSectors, char* data);
+    void WriteSectors(int *sectors, int numSectors, char* data);
+    					// Read/write the "numSectors" sectors
+					// listed in "sectors", to/from
+					// consecutive SectorSize pieces of
+					// "data".  Runs of consecutive
+					// sectors go to the disk as a single
+					// request.
+    int NumSectors() { return disk->Geometry()->NumSectors(); }
+					// how big the disk is
+    void Sync();			// write back all delayed writes
+    void Unpin(int sectorNumber);	// a journaled write may go home
+    void ReadAhead(int sectorNumber);	// start reading a sector into the
+					// cache, without waiting for it
+    void WaitUntilIdle();		// wait until no request is queued
+					// or being served, so background
+					// work can stay out of the way
+
+    void ReadUncached(int sectorNumber, int numSectors, char* data);
+    void WriteUncached(int sectorNumber, int numSectors, char* data);
+					// Bypass the cache, and read/write
+					// consecutive sectors now; used by
+					// the cache itself
+    void WriteAtShutdown(int sectorNumber, char* data);
+    					// Write without waiting for the disk,
+					// when Nachos is halting
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
-    void PlusReader(int sector);
-    void MinusReader(int sector);
-    void BeginWrite(int sector);
-    void EndWrite(int sector);
 
-    int numVisitors[NumSectors];
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
-    Semaphore *mutex[NumSectors];
-    int numReaders[NumSectors];
-    Lock *readerLock;
+    StripedDisk *disk;	  		// Raw disk device(s)
+    BufferCache *cache;			// recently used sectors
+    List *pending;			// DiskRequests not yet started,
+					// sorted by sector
+    DiskRequest *active;		// the one the disk is doing, or NULL
+    int headSector;			// where the head is, or will be once
+					// the active request is done
+    List *idleWaiters;			// Semaphores of threads waiting in
+					// WaitUntilIdle
+
+    void Submit(DiskRequest *request);	// queue a request and wait for it
+    void Start(DiskRequest *request);	// hand a request to the disk
+    DiskRequest *NextRequest();		// take the next one off "pending"
 };
 
 #endif // SYNCHDISK_H
@@ -23,11 +23,23 @@
 #define MagicNumber 	0x456789ab
 #define MagicSize 	sizeof(int)
 
-#define DiskSize 	(MagicSize + (NumSectors * SectorSize))
-
 // dummy procedure because we can't take a pointer of a member function
 static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 
+//----------------------------------------------------------------------
+// DiskGeometry::DiskGeometry()
+// 	Describe the disk Nachos has always had: 32 tracks of 32 sectors,
+//	seeking and rotating at the speeds in stats.h.
+//----------------------------------------------------------------------
+
+DiskGeometry::DiskGeometry()
+{
+    sectorsPerTrack = DefaultSectorsPerTrack;
+    numTracks = DefaultNumTracks;
+    seekTime = SeekTime;
+    rotationTime = RotationTime;
+}
+
 //----------------------------------------------------------------------
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
@@ -35,17 +47,22 @@ static void DiskDone(int arg) { ((Disk *)arg)->HandleInterrupt(); }
 // 	ok to treat it as Nachos disk storage.
 //
 //	"name" -- text name of the file simulating the Nachos disk
+//	"diskGeometry" -- how big and how fast the disk is
 //	"callWhenDone" -- interrupt handler to be called when disk read/write
 //	   request completes
 //	"callArg" -- argument to pass the interrupt handler
 //----------------------------------------------------------------------
 
-Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
+Disk::Disk(char* name, DiskGeometry *diskGeometry,
+	   VoidFunctionPtr callWhenDone, int callArg)
 {
     int magicNum;
     int tmp = 0;
 
     DEBUG('d', "Initializing the disk, 0x%x 0x%x\n", callWhenDone, callArg);
+    geometry = *diskGeometry;
+    ASSERT(geometry.NumSectors() > 0 && geometry.rotationTime > 0);
+    diskSize = MagicSize + geometry.NumSectors() * SectorSize;
     handler = callWhenDone;
     handlerArg = callArg;
     lastSector = 0;
@@ -55,29 +72,79 @@ Disk::Disk(char* name, VoidFunctionPtr callWhenDone, int callArg)
     if (fileno >= 0) {		 	// file exists, check magic number 
 	Read(fileno, (char *) &magicNum, MagicSize);
 	ASSERT(magicNum == MagicNumber);
+	Lseek(fileno, 0, 2);
     } else {				// file doesn't exist, create it
         fileno = OpenForWrite(name);
 	magicNum = MagicNumber;  
 	WriteFile(fileno, (char *) &magicNum, MagicSize); // write magic number
-
+    }
+    if (Tell(fileno) < diskSize) {
 	// need to write at end of file, so that reads will not return EOF
-        Lseek(fileno, DiskSize - sizeof(int), 0);	
+        Lseek(fileno, diskSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+#ifdef DISK_MMAP
+    image = MapFile(fileno, diskSize);
+#endif
     active = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk.  A mapped file gets everything written to it first.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+#ifdef DISK_MMAP
+    SyncMappedFile(image, diskSize);
+    UnmapFile(image, diskSize);
+#endif
     Close(fileno);
 }
 
+//----------------------------------------------------------------------
+// Disk::Sync()
+// 	Make sure the UNIX file holds everything written to the disk so
+//	far.  Only a mapped file needs anything done; otherwise each write
+//	went to the file as it was made.  Takes no simulated time.
+//----------------------------------------------------------------------
+
+void
+Disk::Sync()
+{
+#ifdef DISK_MMAP
+    SyncMappedFile(image, diskSize);
+#endif
+}
+
+//----------------------------------------------------------------------
+// Disk::Transfer()
+// 	Copy "numSectors" sectors from "sectorNumber" on, between the UNIX
+//	file and "data": a memory copy if the file is mapped, else a seek
+//	and a read or write.
+//----------------------------------------------------------------------
+
+void
+Disk::Transfer(int sectorNumber, int numSectors, char *data, bool writing)
+{
+    int offset = SectorSize * sectorNumber + MagicSize;
+
+#ifdef DISK_MMAP
+    if (writing)
+	bcopy(data, &image[offset], SectorSize * numSectors);
+    else
+	bcopy(&image[offset], data, SectorSize * numSectors);
+#else
+    Lseek(fileno, offset, 0);
+    if (writing)
+	WriteFile(fileno, data, SectorSize * numSectors);
+    else
+	Read(fileno, data, SectorSize * numSectors);
+#endif
+}
+
 //----------------------------------------------------------------------
 // Disk::PrintSector()
 // 	Dump the data in a disk read/write request, for debugging.
@@ -115,43 +182,102 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadRequest(sectorNumber, 1, data);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteRequest(sectorNumber, 1, data);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadRequest/WriteRequest
+// 	Simulate a request to read/write "numSectors" consecutive sectors,
+//	starting at "sectorNumber".  As for a single sector, the data is
+//	transferred right away, and an interrupt is scheduled for when
+//	the whole transfer would be done.  Each request counts once in
+//	the statistics, however many sectors it covers.
+//
+//	"data" -- numSectors * SectorSize bytes, to write or to read into
+//----------------------------------------------------------------------
+
+void
+Disk::ReadRequest(int sectorNumber, int numSectors, char* data)
+{
+    int lastTrackStart;
+    int ticks = RunLatency(sectorNumber, numSectors, FALSE, &lastTrackStart);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+	   && (sectorNumber + numSectors <= geometry.NumSectors()));
     
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG('d', "Reading %d sectors from sector %d\n", numSectors, sectorNumber);
+    if (tracer != NULL)
+	tracer->Complete("disk", "read", TraceDiskRow, stats->totalTicks,
+			 ticks, "sector", sectorNumber);
+    Transfer(sectorNumber, numSectors, data, FALSE);
     if (DebugIsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(FALSE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
     UpdateLast(sectorNumber);
+    if (lastTrackStart >= 0)		// the run ended on another track
+	bufferInit = lastTrackStart;
+    lastSector = sectorNumber + numSectors - 1;
     stats->numDiskReads++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, int numSectors, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int lastTrackStart;
+    int ticks = RunLatency(sectorNumber, numSectors, TRUE, &lastTrackStart);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+	   && (sectorNumber + numSectors <= geometry.NumSectors()));
     
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG('d', "Writing %d sectors to sector %d\n", numSectors, sectorNumber);
+    if (tracer != NULL)
+	tracer->Complete("disk", "write", TraceDiskRow, stats->totalTicks,
+			 ticks, "sector", sectorNumber);
+    Transfer(sectorNumber, numSectors, data, TRUE);
     if (DebugIsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(TRUE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
     UpdateLast(sectorNumber);
+    if (lastTrackStart >= 0)
+	bufferInit = lastTrackStart;
+    lastSector = sectorNumber + numSectors - 1;
     stats->numDiskWrites++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
+//----------------------------------------------------------------------
+// Disk::WriteAtShutdown
+// 	Write a sector to the UNIX file (or its mapping) right away.  No time passes and
+//	no interrupt is scheduled: this is used while Nachos is halting,
+//	when there may be no thread left to wait for one.
+//
+//	"sectorNumber" -- the disk sector to write
+//	"data" -- the bytes to be written
+//----------------------------------------------------------------------
+
+void
+Disk::WriteAtShutdown(int sectorNumber, char* data)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < geometry.NumSectors()));
+
+    DEBUG('d', "Writing to sector %d at shutdown\n", sectorNumber);
+    Transfer(sectorNumber, 1, data, TRUE);
+    stats->numDiskWrites++;
+}
+
 //----------------------------------------------------------------------
 // Disk::HandleInterrupt()
 // 	Called when it is time to invoke the disk interrupt handler,
@@ -172,24 +298,24 @@ Disk::HandleInterrupt ()
 //	to be in the middle of a sector that is rotating past the head,
 //	we also return how long until the head is at the next sector boundary.
 //	
-//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
+//   	Disk seeks at one track per seekTime ticks, and rotates at one
+//   	sector per rotationTime ticks (cf. DiskGeometry)
 //----------------------------------------------------------------------
 
 int
 Disk::TimeToSeek(int newSector, int *rotation) 
 {
-    int newTrack = newSector / SectorsPerTrack;
-    int oldTrack = lastSector / SectorsPerTrack;
-    int seek = abs(newTrack - oldTrack) * SeekTime;
+    int newTrack = newSector / geometry.sectorsPerTrack;
+    int oldTrack = lastSector / geometry.sectorsPerTrack;
+    int seek = abs(newTrack - oldTrack) * geometry.seekTime;
 				// how long will seek take?
-    int over = (stats->totalTicks + seek) % RotationTime; 
+    int over = (stats->totalTicks + seek) % geometry.rotationTime; 
 				// will we be in the middle of a sector when
 				// we finish the seek?
 
     *rotation = 0;
     if (over > 0)	 	// if so, need to round up to next full sector
-   	*rotation = RotationTime - over;
+   	*rotation = geometry.rotationTime - over;
     return seek;
 }
 
@@ -202,10 +328,11 @@ Disk::TimeToSeek(int newSector, int *rotation)
 int 
 Disk::ModuloDiff(int to, int from)
 {
-    int toOffset = to % SectorsPerTrack;
-    int fromOffset = from % SectorsPerTrack;
+    int perTrack = geometry.sectorsPerTrack;
+    int toOffset = to % perTrack;
+    int fromOffset = from % perTrack;
 
-    return ((toOffset - fromOffset) + SectorsPerTrack) % SectorsPerTrack;
+    return ((toOffset - fromOffset) + perTrack) % perTrack;
 }
 
 //----------------------------------------------------------------------
@@ -214,8 +341,8 @@ Disk::ModuloDiff(int to, int from)
 //	the current position of the disk head.
 //
 //   	Latency = seek time + rotational latency + transfer time
-//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
+//   	Disk seeks at one track per seekTime ticks, and rotates at one
+//   	sector per rotationTime ticks (cf. DiskGeometry)
 //
 //   	To find the rotational latency, we first must figure out where the 
 //   	disk head will be after the seek (if any).  We then figure out
@@ -232,6 +359,7 @@ Disk::ModuloDiff(int to, int from)
 int
 Disk::ComputeLatency(int newSector, bool writing)
 {
+    int rotationTime = geometry.rotationTime;
     int rotation;
     int seek = TimeToSeek(newSector, &rotation);
     int timeAfter = stats->totalTicks + seek + rotation;
@@ -239,17 +367,59 @@ Disk::ComputeLatency(int newSector, bool writing)
 #ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
     // check if track buffer applies
     if ((writing == FALSE) && (seek == 0) 
-		&& (((timeAfter - bufferInit) / RotationTime) 
-	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
-        DEBUG('d', "Request latency = %d\n", RotationTime);
-	return RotationTime; // time to transfer sector from the track buffer
+		&& (((timeAfter - bufferInit) / rotationTime) 
+	     		> ModuloDiff(newSector, bufferInit / rotationTime))) {
+        DEBUG('d', "Request latency = %d\n", rotationTime);
+	return rotationTime; // time to transfer sector from the track buffer
     }
 #endif
 
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    rotation += ModuloDiff(newSector, timeAfter / rotationTime) * rotationTime;
+
+    DEBUG('d', "Request latency = %d\n", seek + rotation + rotationTime);
+    return(seek + rotation + rotationTime);
+}
+
+//----------------------------------------------------------------------
+// Disk::RunLatency()
+// 	Return how long it will take to read/write "numSectors" consecutive
+//	sectors starting at "firstSector".  The first sector costs what
+//	ComputeLatency says.  After that, the head is at the start of the
+//	next sector, so each further sector on the same track only costs
+//	its transfer time.  Moving on to the next track costs a one-track
+//	seek plus the rotational delay to the wanted sector.
+//
+//	"lastTrackStart" is set to when the head reached the last track
+//	of the run (when the track buffer started loading), or -1 if the
+//	run stays on the track it started on.
+//----------------------------------------------------------------------
 
-    DEBUG('d', "Request latency = %d\n", seek + rotation + RotationTime);
-    return(seek + rotation + RotationTime);
+int
+Disk::RunLatency(int firstSector, int numSectors, bool writing,
+		 int *lastTrackStart)
+{
+    int rotationTime = geometry.rotationTime;
+    int ticks = ComputeLatency(firstSector, writing);
+
+    *lastTrackStart = -1;
+    for (int sector = firstSector + 1; sector < firstSector + numSectors;
+								sector++) {
+	if (sector % geometry.sectorsPerTrack != 0) {	// streams right after
+	    ticks += rotationTime;
+	    continue;
+	}
+	int when = stats->totalTicks + ticks + geometry.seekTime;
+	int rotation = 0;
+
+	if (when % rotationTime > 0)	// wait for a sector boundary
+	    rotation = rotationTime - when % rotationTime;
+	*lastTrackStart = when + rotation;
+	rotation += ModuloDiff(sector, *lastTrackStart / rotationTime)
+							* rotationTime;
+	ticks += geometry.seekTime + rotation + rotationTime;
+    }
+    DEBUG('d', "Request latency for %d sectors = %d\n", numSectors, ticks);
+    return ticks;
 }
 
 //----------------------------------------------------------------------
@@ -26,7 +26,13 @@
 // sector has the same number of bytes of storage).  
 //
 // Addressing is by sector number -- each sector on the disk is given
-// a unique number: track * SectorsPerTrack + offset within a track.
+// a unique number: track * sectors per track + offset within a track.
+//
+// How many tracks there are, how many sectors are on each, and how
+// fast the disk seeks and rotates is given by a DiskGeometry when the
+// disk is created, so that disks of different sizes and speeds can be
+// modelled, several at once.  The sector size is fixed, since the file
+// system lays out its headers and directories in whole sectors.
 //
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -45,18 +51,42 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// Compiling with -DDISK_MMAP maps the UNIX file into memory once, when
+// the disk is created, so a transfer is a memory copy rather than a
+// seek and a read or write of the file.  The changes reach the file
+// when Sync is called, and when the disk is deleted as Nachos halts.
+// Simulated time is the same either way.
 
 #define SectorSize 		128	// number of bytes per disk sector
-#define SectorsPerTrack 	32	// number of sectors per disk track 
-#define NumTracks 		32	// number of tracks per disk
-#define NumSectors 		(SectorsPerTrack * NumTracks)
+#define DefaultSectorsPerTrack 	32	// geometry of the disk we get if
+#define DefaultNumTracks 	32	// nothing else is asked for
+
+// The following class describes the size and speed of a disk.
+class DiskGeometry {
+  public:
+    DiskGeometry();			// the default disk: DefaultNumTracks
+					// tracks of DefaultSectorsPerTrack,
+					// with the times from stats.h
+
+    int sectorsPerTrack;		// number of sectors per disk track
+    int numTracks;			// number of tracks per disk
+    int seekTime;			// time to seek past one track
+    int rotationTime;			// time to rotate past one sector
+
+    int NumSectors() { return sectorsPerTrack * numTracks; }
 					// total # of sectors per disk
+};
 
 class Disk {
   public:
-    Disk(char* name, VoidFunctionPtr callWhenDone, int callArg);
-    					// Create a simulated disk.  
-					// Invoke (*callWhenDone)(callArg) 
+    Disk(char* name, DiskGeometry *geometry, VoidFunctionPtr callWhenDone,
+	 int callArg);
+    					// Create a simulated disk shaped like
+					// "geometry".  If the UNIX file is
+					// from a smaller disk, it is made
+					// bigger.  Invoke
+					// (*callWhenDone)(callArg) 
 					// every time a request completes.
     ~Disk();				// Deallocate the disk.
     
@@ -66,6 +96,20 @@ class Disk {
     					// the disk and return immediately.
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
+    void ReadRequest(int sectorNumber, int numSectors, char* data);
+    void WriteRequest(int sectorNumber, int numSectors, char* data);
+    					// Read/write "numSectors" consecutive
+					// sectors in one request.  Sectors
+					// on the same track stream past the
+					// head with no rotational delay.
+    void WriteAtShutdown(int sectorNumber, char* data);
+    					// Write a sector straight to the
+					// UNIX file, with no interrupt; only
+					// for flushing caches when Nachos
+					// halts and nothing can wait any more
+
+    void Sync();			// Make sure everything written so far
+					// is in the UNIX file
 
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
@@ -75,8 +119,15 @@ class Disk {
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
 
+    DiskGeometry *Geometry() { return &geometry; }
+
   private:
+    DiskGeometry geometry;		// size and speed of this disk
+    int diskSize;			// bytes in the UNIX file
     int fileno;				// UNIX file number for simulated disk 
+#ifdef DISK_MMAP
+    char *image;			// the UNIX file, mapped into memory
+#endif
     VoidFunctionPtr handler;		// Interrupt handler, to be invoked 
 					// when any disk request finishes
     int handlerArg;			// Argument to interrupt handler 
@@ -86,8 +137,14 @@ class Disk {
 					// being loaded
 
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
+    int RunLatency(int firstSector, int numSectors, bool writing,
+		   int *lastTrackStart);	// ComputeLatency for a run of
+						// consecutive sectors
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
+    void Transfer(int sectorNumber, int numSectors, char *data,
+		  bool writing);	// move the data to or from the
+					// UNIX file
 };
 
 #endif // DISK_H
@@ -156,9 +156,11 @@ Interrupt::OneTick()
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
 	stats->systemTicks += SystemTick;
+	currentThread->systemTicks += SystemTick;
     } else {					// USER_PROGRAM
 	stats->totalTicks += UserTick;
 	stats->userTicks += UserTick;
+	currentThread->userTicks += UserTick;
     }
     //printf("== Tick %d ==\n",stats->totalTicks);
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
@@ -173,10 +175,12 @@ Interrupt::OneTick()
     if (yieldOnReturn) {		// if the timer device handler asked 
     //printf("%s\n",currentThread->getName());
 					// for a context switch, ok to do it now
-    currentThread->setpriorty(currentThread->getpriorty()+1);
+    currentThread->setpriorty(currentThread->getBasePriority()+1);
 	yieldOnReturn = FALSE;
  	status = SystemMode;		// yield is a kernel routine
+	currentThread->preempted = TRUE;
 	currentThread->Yield();
+	currentThread->preempted = FALSE;
 	status = old;
     }
 }
@@ -245,6 +249,13 @@ Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+    if (schedTraceFile != NULL) {
+	for (int i = 0; i < 128; i++)
+	    if (tid_alloc[i])
+		tid_pointer[i]->PrintAccounting();
+	schedTrace->Print();
+	schedTrace->Dump(schedTraceFile);
+    }
     Cleanup();     // Never returns.
 }
 
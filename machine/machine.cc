@@ -113,11 +113,29 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
+    int start = stats->totalTicks;
+    int syscallType = registers[2];	// the handler may overwrite r2
+
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     interrupt->setStatus(UserMode);
+    InvalidatePageCaches();		// the handler may have changed the
+					// TLB or the page table
+    if (tracer != NULL) {		// Halt and Exit never get here
+	if (which == SyscallException)
+	    tracer->Complete("syscall", "syscall", currentThread->getTid(),
+			     start, stats->totalTicks - start,
+			     "code", syscallType);
+	else if (which == PageFaultException)
+	    tracer->Complete("vm", tlb != NULL ? "tlb miss" : "page fault",
+			     currentThread->getTid(), start,
+			     stats->totalTicks - start, "vaddr", badVAddr);
+	else
+	    tracer->Instant("exception", exceptionNames[which],
+			    currentThread->getTid(), "vaddr", badVAddr);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -291,7 +309,8 @@ void Machine::TLBswap(int virtAddr){
         tlb[index].dirty = false;
         tlbUpdate(index);
         tlb[index].hit_time = 0;
-        printf("tlb swap function,Thread: %s, virAddr:0x%x physicalPage:%d\n",currentThread->getName(),virtAddr,tlb[index].physicalPage);
+        LOG('v', "tlb swap function,Thread: %s, virAddr:0x%x physicalPage:%d\n",
+	    currentThread->getName(), virtAddr, tlb[index].physicalPage);
     }
 }
 
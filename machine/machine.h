@@ -91,6 +91,32 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// The following class remembers the last page that was translated, so
+// that further aligned word accesses to the same page can go straight to
+// mainMemory without calling Translate.  Machine keeps one for loads and
+// stores, and one for instruction fetch.  It must be invalidated whenever
+// the TLB or page table might have changed; the kernel only changes them
+// from exception handlers and on context switches, so RaiseException and
+// AddrSpace::RestoreState do that.
+
+class PageCache {
+  public:
+    PageCache() { Invalidate(); }
+    void Invalidate() { vpn = -1; }	// forget the cached page
+
+    char *Lookup(int addr)		// host address of "addr", or NULL
+	{ return ((int) ((unsigned) addr / PageSize) == vpn) ?
+		 page + ((unsigned) addr % PageSize) : NULL; }
+    void Fill(int addr, char *host, bool canWrite)
+	{ vpn = (unsigned) addr / PageSize;	// "host" is where "addr" is
+	  page = host - (unsigned) addr % PageSize;
+	  writable = canWrite; }
+
+    int vpn;				// virtual page cached, -1 if none
+    char *page;				// where it is in mainMemory
+    bool writable;			// use and dirty bits are already set
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -131,6 +157,12 @@ class Machine {
     				// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+    bool FetchInstruction(int addr, int* value);
+    				// ReadMem of a word, through the
+				// instruction fetch page cache
+
+    void InvalidatePageCaches()	// the TLB or page table has changed
+	{ dataCache.Invalidate(); instrCache.Invalidate(); }
     
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
@@ -192,6 +224,13 @@ class Machine {
     unsigned int pageTableSize;
 
   private:
+    PageCache dataCache;	// last page loaded from or stored to
+    PageCache instrCache;	// last page instructions were fetched from
+
+    bool ReadWord(int addr, int* value, PageCache *cache);
+				// ReadMem for an aligned word, filling
+				// "cache" from the translation
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -102,7 +102,7 @@ Machine::OneInstruction(Instruction *instr)
 				// in the future
 
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
+    if (!machine->FetchInstruction(registers[PCReg], &raw))
 	return;			// exception occurred
     instr->value = raw;
     instr->Decode();
@@ -81,6 +81,8 @@ Network::CheckPktAvail()
     DEBUG('n', "Network received packet from %d, length %d...\n",
 	  				(int) inHdr.from, inHdr.length);
     stats->numPacketsRecvd++;
+    if (tracer != NULL)
+	tracer->Instant("net", "receive", TraceNetworkRow, "from", inHdr.from);
 
     // tell post office that the packet has arrived
     (*readHandler)(handlerArg);	
@@ -110,6 +112,8 @@ Network::Send(PacketHeader hdr, char* data)
     ASSERT((sendBusy == FALSE) && (hdr.length > 0) 
 		&& (hdr.length <= MaxPacketSize) && (hdr.from == ident));
     DEBUG('n', "Sending to addr %d, %d bytes... ", hdr.to, hdr.length);
+    if (tracer != NULL)
+	tracer->Instant("net", "send", TraceNetworkRow, "to", hdr.to);
 
     interrupt->Schedule(NetworkSendDone, (int)this, NetworkTime, NetworkSendInt);
 
@@ -20,6 +20,9 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numCacheHits = numCacheMisses = numReadAheads = 0;
+    numJournalCommits = numJournalSectors = 0;
+    numDefragSectors = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
 }
@@ -36,6 +39,14 @@ Statistics::Print()
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numCacheHits + numCacheMisses > 0)
+	printf("Buffer cache: hits %d, misses %d, read ahead %d\n",
+	    numCacheHits, numCacheMisses, numReadAheads);
+    if (numJournalCommits > 0)
+	printf("Journal: commits %d, sectors logged %d\n",
+	    numJournalCommits, numJournalSectors);
+    if (numDefragSectors > 0)
+	printf("Defragmenter: sectors moved %d\n", numDefragSectors);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
     printf("Paging: faults %d\n", numPageFaults);
@@ -30,6 +30,12 @@ class Statistics {
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numCacheHits;		// sector requests found in the buffer cache
+    int numCacheMisses;		// sector requests that were not
+    int numReadAheads;		// sectors read ahead into the cache
+    int numJournalCommits;	// metadata transactions committed
+    int numJournalSectors;	// sectors written by those transactions
+    int numDefragSectors;	// data sectors moved by the defragmenter
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
@@ -53,6 +59,7 @@ class Statistics {
 #define SystemTick 	10 	// advance each time interrupts are enabled
 #define RotationTime 	500 	// time disk takes to rotate one sector
 #define SeekTime 	500    	// time disk takes to seek past one track
+				// (the defaults; cf. DiskGeometry)
 #define ConsoleTime 	100	// time to read or write one character
 #define NetworkTime 	100   	// time to send or receive one packet
 #define TimerTicks 	50    	// (average) time between timer interrupts
@@ -91,6 +91,9 @@ Machine::ReadMem(int addr, int size, int *value)
     ExceptionType exception;
     int physicalAddress;
     
+    if (size == 4 && !(addr & 0x3))
+	return ReadWord(addr, value, &dataCache);
+
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
     exception = Translate(addr, &physicalAddress, size, FALSE);
@@ -121,6 +124,62 @@ Machine::ReadMem(int addr, int size, int *value)
     return (TRUE);
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+//      Read the instruction word at virtual address "addr".  The same
+//	as ReadMem(addr, 4, value), except that it keeps its own page
+//	cache, so that instruction fetches and data accesses to different
+//	pages do not keep evicting each other.
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchInstruction(int addr, int *value)
+{
+    return ReadWord(addr, value, &instrCache);
+}
+
+//----------------------------------------------------------------------
+// Machine::ReadWord
+//      ReadMem of an aligned word.  If "addr" is on the page "cache"
+//	remembers, read mainMemory directly; otherwise go through
+//	Translate, and remember the page for next time.
+//
+//	Skipping Translate on a hit does not change what it would have
+//	done: the use bit is already set, and TLB hits only age the
+//	other entries uniformly, which does not change which one is
+//	replaced next.  Only the hit counter needs updating.
+//----------------------------------------------------------------------
+
+bool
+Machine::ReadWord(int addr, int *value, PageCache *cache)
+{
+    ExceptionType exception;
+    int physicalAddress;
+    char *host = cache->Lookup(addr);
+
+    if (likely(host != NULL)) {
+	if (tlb != NULL)
+	    TLBhit_num++;
+	*value = WordToHost(*(unsigned int *) host);
+	return TRUE;
+    }
+
+    DEBUG('a', "Reading VA 0x%x, size 4\n", addr);
+
+    exception = Translate(addr, &physicalAddress, 4, FALSE);
+    if (exception != NoException) {
+	machine->RaiseException(exception, addr);
+	return FALSE;
+    }
+    host = &mainMemory[physicalAddress];
+    *value = WordToHost(*(unsigned int *) host);
+    if (!DebugIsEnabled('a'))		// keep tracing every access
+	cache->Fill(addr, host, FALSE);
+
+    DEBUG('a', "\tvalue read = %8.8x\n", *value);
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // Machine::WriteMem
 //      Write "size" (1, 2, or 4) bytes of the contents of "value" into
@@ -140,6 +199,17 @@ Machine::WriteMem(int addr, int size, int value)
     ExceptionType exception;
     int physicalAddress;
      
+    if (size == 4 && !(addr & 0x3)) {	// fast path, cf. ReadWord
+	char *host = dataCache.Lookup(addr);
+
+	if (likely(host != NULL && dataCache.writable)) {
+	    if (tlb != NULL)
+		TLBhit_num++;
+	    *(unsigned int *) host = WordToMachine((unsigned int) value);
+	    return TRUE;
+	}
+    }
+
     DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
     exception = Translate(addr, &physicalAddress, size, TRUE);
@@ -160,6 +230,8 @@ Machine::WriteMem(int addr, int size, int value)
       case 4:
 	*(unsigned int *) &machine->mainMemory[physicalAddress]
 		= WordToMachine((unsigned int) value);
+	if (!DebugIsEnabled('a'))	// the dirty bit is set now
+	    dataCache.Fill(addr, &mainMemory[physicalAddress], TRUE);
 	break;
 	
       default: ASSERT(FALSE);
@@ -8,16 +8,22 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
+// Usage: nachos -d <debugflags> -rs <random seed #> -st <trace file>
+//		-tr <json file>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+//		-nd <# disks> -md <disk #> -su <stripe unit>
+//		-dg <tracks> <sectors per track> <seek time> <rotation time>
+//		-p <nachos file> -r <nachos file> -l -D -t -ra -ck -ckr -df
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -st dumps per-thread accounting and the scheduler event trace
+//	into the given UNIX file when Nachos halts
+//    -tr writes a Chrome trace-event JSON timeline into the given UNIX file
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
@@ -27,12 +33,25 @@
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -nd sets how many disks there are, in UNIX files DISK, DISK1, ...
+//    -md puts the file system on that disk (0 is DISK)
+//    -su stripes all the disks into one, that many sectors at a time;
+//	the disks must be formatted (-f) striped the same way
+//    -dg sets the size and speed of every disk (cf. DiskGeometry); the
+//	disk the file system sees may be no bigger than a file can be
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -ra reads a file sequentially, racing the read-ahead thread
+//    -pt streams data through a kernel pipe
+//    -dt creates and opens files in one directory from several threads
+//    -jt removes a file and halts before that commits; run it again to
+//	check that the file comes back from the journal intact
+//    -ck checks the file system for consistency; -ckr also repairs it
+//    -df defragments the file system in the background
 //
 //  NETWORK
 //    -n sets the network reliability
@@ -60,9 +79,11 @@ extern int testnum;
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
-extern void Print(char *file), PerformanceTest(void);
+extern void Print(char *file), PerformanceTest(void), ReadAheadTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
-extern void MailTest(int networkID),Test1(void),Test2(void);
+extern void MailTest(int networkID), PipeTest(void), DirectoryTest(void);
+extern void JournalTest(void);
+extern void Check(bool repair), Defragment(void);
 
 //----------------------------------------------------------------------
 // main
@@ -145,13 +166,23 @@ main(int argc, char **argv)
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-ra")) {	// read-ahead test
+            ReadAheadTest();
+	} else if (!strcmp(*argv, "-ck")) {	// check the file system
+            Check(FALSE);
+	} else if (!strcmp(*argv, "-ckr")) {	// check and repair it
+            Check(TRUE);
+	} else if (!strcmp(*argv, "-df")) {	// start the defragmenter
+            Defragment();
 	}else if (!strcmp(*argv,"-cd")){
         fileSystem->Create(*(argv+1),-1);
         argCount=2;
-    }else if(!strcmp(*argv,"-pt1")){
-        Test1();
-    }else if(!strcmp(*argv,"-pt2")){
-        Test2();
+    }else if(!strcmp(*argv,"-pt")){
+        PipeTest();
+    }else if(!strcmp(*argv,"-dt")){	// concurrent directory test
+        DirectoryTest();
+    }else if(!strcmp(*argv,"-jt")){	// journal replay test
+        JournalTest();
     }
 #endif // FILESYS
 #ifdef NETWORK
@@ -0,0 +1,108 @@
+// schedtrace.cc
+//	Routines to record scheduler events into a fixed-size ring buffer,
+//	and to dump them once Nachos is done.
+//
+//	Record is called with interrupts disabled from the scheduler and
+//	thread routines, so no further synchronization is needed.
+
+#include "copyright.h"
+#include "schedtrace.h"
+#include "system.h"
+
+static char *schedEventNames[] = { "fork", "wake", "yield", "block",
+				   "switch", "finish" };
+
+//----------------------------------------------------------------------
+// SchedTrace::SchedTrace
+// 	Initialize an empty trace.
+//----------------------------------------------------------------------
+
+SchedTrace::SchedTrace()
+{
+    ring = new SchedEvent[SchedTraceSize];
+    next = 0;
+    count = 0;
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::~SchedTrace
+// 	De-allocate the ring buffer.
+//----------------------------------------------------------------------
+
+SchedTrace::~SchedTrace()
+{
+    delete [] ring;
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::Record
+// 	Append an event to the ring, overwriting the oldest event once
+//	the ring is full.
+//
+//	"type" -- what happened
+//	"thread" -- the thread it happened to
+//	"arg" -- event specific value (cf. schedtrace.h)
+//----------------------------------------------------------------------
+
+void
+SchedTrace::Record(SchedEventType type, Thread *thread, int arg)
+{
+    SchedEvent *event = &ring[next];
+
+    event->when = stats->totalTicks;
+    event->type = type;
+    event->tid = thread->getTid();
+    event->arg = arg;
+    next = (next + 1) % SchedTraceSize;
+    if (count < SchedTraceSize)
+	count++;
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::Print
+// 	Print the events in the ring, oldest first.
+//----------------------------------------------------------------------
+
+void
+SchedTrace::Print()
+{
+    int first = (next - count + SchedTraceSize) % SchedTraceSize;
+
+    printf("Scheduler trace, last %d events:\n", count);
+    for (int i = 0; i < count; i++) {
+	SchedEvent *event = &ring[(first + i) % SchedTraceSize];
+	printf("%8d %-6s tid %d", event->when, schedEventNames[event->type],
+	       event->tid);
+	if (event->type == SchedSwitch)
+	    printf(" -> tid %d", event->arg);
+	else if (event->type == SchedYield && event->arg)
+	    printf(" (preempted)");
+	else if (event->type == SchedFinish)
+	    printf(" after %d ticks", event->arg);
+	printf("\n");
+    }
+}
+
+//----------------------------------------------------------------------
+// SchedTrace::Dump
+// 	Write the raw SchedEvent records, oldest first, into a UNIX file,
+//	for post-processing outside of Nachos.
+//
+//	"fileName" -- the UNIX file to create
+//----------------------------------------------------------------------
+
+void
+SchedTrace::Dump(char *fileName)
+{
+    int first = (next - count + SchedTraceSize) % SchedTraceSize;
+    int fd = OpenForWrite(fileName);
+
+    if (first + count <= SchedTraceSize)
+	WriteFile(fd, (char *) &ring[first], count * sizeof(SchedEvent));
+    else {
+	WriteFile(fd, (char *) &ring[first],
+		  (SchedTraceSize - first) * sizeof(SchedEvent));
+	WriteFile(fd, (char *) ring, next * sizeof(SchedEvent));
+    }
+    Close(fd);
+}
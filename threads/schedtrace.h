@@ -0,0 +1,61 @@
+// schedtrace.h
+//	Data structures for recording scheduler events.
+//
+//	The scheduler writes one small fixed-size binary record into a
+//	ring buffer every time something interesting happens to a thread
+//	(it is forked, blocks, is woken up, gets switched in, yields or
+//	finishes).  Recording is cheap enough to leave on all the time;
+//	the buffer only keeps the most recent SchedTraceSize events, and
+//	is dumped when Nachos halts if it was asked for on the command
+//	line (-st).
+
+#ifndef SCHEDTRACE_H
+#define SCHEDTRACE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define SchedTraceSize	1024		// number of events kept in the ring
+
+class Thread;
+
+// What happened to the thread.
+enum SchedEventType { SchedFork,	// put on the ready list for the 1st time
+		      SchedWake,	// blocked -> ready
+		      SchedYield,	// running -> ready (arg: 1 if preempted)
+		      SchedBlock,	// running -> blocked
+		      SchedSwitch,	// switched out (arg: tid switched in)
+		      SchedFinish,	// done (arg: ticks it ran for)
+		      NumSchedEventTypes };
+
+// One binary record in the trace.  This is also the on-disk format
+// written by SchedTrace::Dump, in host byte order.
+class SchedEvent {
+  public:
+    int when;				// stats->totalTicks at the event
+    short type;				// a SchedEventType
+    short tid;				// the thread the event is about
+    int arg;				// event specific, see above
+};
+
+// The following class defines the ring buffer of scheduler events.
+class SchedTrace {
+  public:
+    SchedTrace();			// initialize an empty trace
+    ~SchedTrace();
+
+    void Record(SchedEventType type, Thread *thread, int arg);
+    					// append an event, overwriting the
+					// oldest one if the ring is full
+
+    void Print();			// print the events, oldest first
+    void Dump(char *fileName);		// write the raw events, oldest
+					// first, into a UNIX file
+
+  private:
+    SchedEvent *ring;			// the events
+    int next;				// slot the next event goes into
+    int count;				// number of valid events in the ring
+};
+
+#endif // SCHEDTRACE_H
@@ -55,6 +55,13 @@ Scheduler::ReadyToRun (Thread *thread)
 {
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    if (thread->getStatus() == JUST_CREATED)
+	schedTrace->Record(SchedFork, thread, 0);
+    else if (thread->getStatus() == BLOCKED)
+	schedTrace->Record(SchedWake, thread, 0);
+    else
+	schedTrace->Record(SchedYield, thread, thread->preempted);
+    thread->readySince = stats->totalTicks;
     thread->setStatus(READY);
 #ifdef PRIORITY
     readyList->SortedInsert((void *)thread,thread->getpriorty());
@@ -67,6 +74,25 @@ Scheduler::ReadyToRun (Thread *thread)
     //}
 }
 
+//----------------------------------------------------------------------
+// Scheduler::Reposition
+// 	A thread already on the ready list has had its priority changed
+//	(for instance, by priority inheritance in Lock::Acquire).  Move it
+//	to the place on the ready list that matches its new priority.
+//
+//	"thread" is the ready thread whose priority changed.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Reposition (Thread *thread)
+{
+#ifdef PRIORITY
+    ASSERT(interrupt->getLevel() == IntOff);
+    readyList->Remove((void *)thread);
+    readyList->SortedInsert((void *)thread, thread->getpriorty());
+#endif
+}
+
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
 // 	Return the next thread to be scheduled onto the CPU.
@@ -110,6 +136,15 @@ Scheduler::Run (Thread *nextThread)
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
+    if (oldThread->preempted)		    // charge the switch to the
+	oldThread->involuntarySwitches++;   // thread giving up the CPU
+    else
+	oldThread->voluntarySwitches++;
+    nextThread->readyWaitTicks += stats->totalTicks - nextThread->readySince;
+    schedTrace->Record(SchedSwitch, oldThread, nextThread->getTid());
+    if (tracer != NULL)
+	tracer->Switch(oldThread, nextThread);
+
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
     
@@ -97,33 +97,129 @@ Semaphore::V()
     (void) interrupt->SetLevel(oldLevel);
 }
 
-// Dummy functions -- so we can compile our later assignments 
-// Note -- without a correct implementation of Condition::Wait(), 
-// the test case in the network assignment won't work!
+//----------------------------------------------------------------------
+// Lock::Lock
+// 	Initialize a lock, so that it can be used for synchronization.
+//	The lock starts out FREE, with nobody waiting for it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
 Lock::Lock(char* debugName) {
     name=debugName;
-    lock=new Semaphore(debugName,1);
+    queue=new List;
     t=NULL;
 }
+
+//----------------------------------------------------------------------
+// Lock::~Lock
+// 	De-allocate a lock.  Assume no one holds it or is waiting on it!
+//----------------------------------------------------------------------
+
 Lock::~Lock() {
-    delete lock;
+    delete queue;
 }
+
+//----------------------------------------------------------------------
+// Lock::Acquire
+// 	Wait until the lock is FREE, then take it.  While we wait, our
+//	priority is lent to the holder so that it cannot be starved by
+//	threads of intermediate priority (priority inheritance).
+//
+//	There is no retry loop: Release hands the lock over to us
+//	directly, so when we wake up we already own it.
+//----------------------------------------------------------------------
+
 void Lock::Acquire() {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
-    lock->P();
-    t=currentThread;
+    if(t==NULL){
+        t=currentThread;
+        t->heldLocks->Append((void *)this);
+    }else{
+        ASSERT(t!=currentThread);		// no recursive locking
+        currentThread->waitingOn=this;
+#ifdef PRIORITY
+        t->DonatePriority(currentThread->getpriorty());
+#endif
+        queue->Append((void *)currentThread);
+        currentThread->Sleep();
+        ASSERT(t==currentThread);		// handed over by Release
+    }
     (void) interrupt->SetLevel(oldLevel);
 }
+
+//----------------------------------------------------------------------
+// Lock::Release
+// 	Set the lock FREE, or, if someone is waiting, hand it directly to
+//	the waiter with the best priority.  The old holder loses whatever
+//	priority it inherited through this lock.
+//
+//	If the new holder now outranks us, give it the CPU right away --
+//	but only when we were called with interrupts on, since callers
+//	like Condition::Wait rely on Release not switching threads.
+//----------------------------------------------------------------------
+
 void Lock::Release() {
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
-    //ASSERT(currentThread==t);
-    lock->V();
-    t=NULL;
+    ASSERT(currentThread==t);
+    Thread *oldHolder=t;
+    Thread *next=NULL;
+
+    ASSERT(oldHolder!=NULL);
+    oldHolder->heldLocks->Remove((void *)this);
+    if(!queue->IsEmpty()){
+#ifdef PRIORITY
+        for(ListElement *ptr=queue->getfirst();ptr!=NULL;ptr=ptr->next){
+            Thread *waiter=(Thread *)ptr->item;
+            if(next==NULL||waiter->getpriorty()<next->getpriorty())
+                next=waiter;
+        }
+        queue->Remove((void *)next);
+#else
+        next=(Thread *)queue->Remove();
+#endif
+        next->waitingOn=NULL;
+        next->heldLocks->Append((void *)this);
+        DEBUG('s', "Lock \"%s\" handed to thread \"%s\"\n", name,
+              next->getName());
+    }
+    t=next;
+#ifdef PRIORITY
+    oldHolder->RestorePriority();
+    if(next!=NULL)
+        next->RestorePriority();
+#endif
+    if(next!=NULL)
+        scheduler->ReadyToRun(next);
+#ifdef PRIORITY
+    if(next!=NULL&&oldLevel==IntOn&&oldHolder==currentThread
+            &&next->getpriorty()<currentThread->getpriorty())
+        currentThread->Yield();
+#endif
     (void) interrupt->SetLevel(oldLevel);
 }
+
 bool Lock::isHeldByCurrentThread(){
     return currentThread==t;
 }
+
+//----------------------------------------------------------------------
+// Lock::TopWaiterPriority
+// 	Return the best (smallest) priority of the threads waiting for
+//	this lock, or a value no thread can beat if nobody is waiting.
+//	Used by Thread::RestorePriority to compute inherited priority.
+//----------------------------------------------------------------------
+
+int Lock::TopWaiterPriority(){
+    int best=0x7fffffff;
+    for(ListElement *ptr=queue->getfirst();ptr!=NULL;ptr=ptr->next){
+        int p=((Thread *)ptr->item)->getpriorty();
+        if(p<best)
+            best=p;
+    }
+    return best;
+}
+
 Condition::Condition(char* debugName) { 
     name=debugName;
     queue=new List;    
@@ -150,42 +246,68 @@ void Condition::Signal(Lock* conditionLock) {
     }
     (void) interrupt->SetLevel(oldLevel);
 }
-void Condition::Broadcast(Lock* conditionLock) { }
+void Condition::Broadcast(Lock* conditionLock) {
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    if(conditionLock->isHeldByCurrentThread()){
+        while(!queue->IsEmpty()){
+            Thread* t=(Thread *)queue->Remove();
+            scheduler->ReadyToRun(t);
+        }
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock
+// 	Many readers or one writer.  "lock" guards the reader count and
+//	the writer; it is only held inside these routines, so every
+//	Acquire and Release of it is done by the same thread.  Readers
+//	come in as long as no writer holds the lock, even if one is
+//	waiting for it.  Readers do not lend a waiting writer their
+//	priority; only "lock" itself does that, for as long as it is held.
+//----------------------------------------------------------------------
 
 RWLock::RWLock(char* debugName){
     name=debugName;
-    readers=new List;
+    lock=new Lock(debugName);
+    readable=new Condition(debugName);
+    writable=new Condition(debugName);
+    readers=0;
     writer=NULL;
-    char *r_name = (char*) malloc(strlen(debugName)+4);
-    char *w_name = (char*) malloc(strlen(debugName)+4);
-    sprintf(r_name,"%s_r",debugName);
-    sprintf(w_name,"%s_w",debugName);
-    r_lock=new Lock(r_name);
-    w_lock=new Lock(w_name);
 }
 RWLock::~RWLock(){
-    delete readers;
-    delete r_lock;
-    delete w_lock;
+    delete lock;
+    delete readable;
+    delete writable;
 }
 void RWLock::Acquire_w(){
-    w_lock->Acquire();
+    lock->Acquire();
+    ASSERT(writer!=currentThread);
+    while(writer!=NULL||readers>0)
+        writable->Wait(lock);
+    writer=currentThread;
+    lock->Release();
 }
 void RWLock::Release_w(){
-    w_lock->Release();
+    lock->Acquire();
+    ASSERT(writer==currentThread);
+    writer=NULL;
+    readable->Broadcast(lock);
+    writable->Signal(lock);
+    lock->Release();
 }
 void RWLock::Acquire_r(){
-    r_lock->Acquire();
-    if(readers->IsEmpty())
-        w_lock->Acquire();
-    readers->Append(currentThread);
-    r_lock->Release();
+    lock->Acquire();
+    ASSERT(writer!=currentThread);
+    while(writer!=NULL)
+        readable->Wait(lock);
+    readers++;
+    lock->Release();
 }
 void RWLock::Release_r(){
-    r_lock->Acquire();
-    readers->Remove(currentThread);
-    if(readers->IsEmpty()){
-        w_lock->Release();
-    }
-    r_lock->Release();
+    lock->Acquire();
+    ASSERT(readers>0);
+    if(--readers==0)
+        writable->Signal(lock);
+    lock->Release();
 }
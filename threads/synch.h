@@ -62,6 +62,11 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// Under the PRIORITY scheduler, a thread blocked in Acquire lends its
+// priority to the holder (and, transitively, to whoever that holder is
+// blocked on), and Release hands the lock directly to the waiter with
+// the best priority instead of letting the waiters race for it.
 
 class Lock {
   public:
@@ -77,11 +82,13 @@ class Lock {
 					// checking in Release, and in
 					// Condition variable ops below.
 
+    Thread* getHolder() { return t; }	// thread currently owning the lock
+    int TopWaiterPriority();		// best priority among the waiters
+
   private:
     char* name;				// for debugging
-    Semaphore* lock;
-    Thread* t;
-    // plus some other stuff you'll need to define
+    List* queue;			// threads waiting in Acquire()
+    Thread* t;				// current owner, NULL if FREE
 };
 
 // The following class defines a "condition variable".  A condition
@@ -149,10 +156,11 @@ class RWLock{
     void Release_r();
   private:
     char* name;
-    List* readers;
-    Thread* writer;
-    Lock* r_lock;
-    Lock* w_lock;
+    Lock* lock;			// guards readers and writer
+    Condition* readable;	// signalled when the writer leaves
+    Condition* writable;	// signalled when nobody holds it
+    int readers;		// how many threads hold it to read
+    Thread* writer;		// the thread holding it to write, if any
 };
 
 #endif // SYNCH_H
@@ -18,6 +18,9 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+SchedTrace *schedTrace;			// recent scheduler events
+char *schedTraceFile;			// dump the trace here at Halt
+Tracer *tracer;				// Chrome trace export, if enabled
 
 bool tid_alloc[128];
 Thread* tid_pointer[128];
@@ -27,12 +30,17 @@ FileSystem  *fileSystem;
 #endif
 
 #ifdef FILESYS
+SynchDisk   *disks[MaxDisks];
+int numDisks;
 SynchDisk   *synchDisk;
+HeaderTable *headerTable;
+Journal     *journal;
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
 memoryManager *memMa;
+PipeTable *pipeTable;
 #endif
 
 #ifdef NETWORK
@@ -83,6 +91,7 @@ Initialize(int argc, char **argv)
 {
     int argCount;
     char* debugArgs = "";
+    char* traceFile = NULL;
     bool randomYield = FALSE;
 
 #ifdef USER_PROGRAM
@@ -91,11 +100,21 @@ Initialize(int argc, char **argv)
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    DiskGeometry geometry;	// of every disk
+    int mountDisk = 0;		// the disk to put the file system on
+    int stripeUnit = 0;		// if not 0, stripe all the disks into one
+    char diskName[16];
+    int diskSectors;		// of the disk the file system sees
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
 #endif
     
+#ifdef FILESYS
+    numDisks = 1;
+#endif
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
 	argCount = 1;
 	if (!strcmp(*argv, "-d")) {
@@ -111,6 +130,14 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-st")) {
+	    ASSERT(argc > 1);
+	    schedTraceFile = *(argv + 1);	// dump scheduler trace and
+	    argCount = 2;			// per-thread accounting at Halt
+	} else if (!strcmp(*argv, "-tr")) {
+	    ASSERT(argc > 1);
+	    traceFile = *(argv + 1);		// write a Chrome trace
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
@@ -120,6 +147,28 @@ Initialize(int argc, char **argv)
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-nd")) {
+	    ASSERT(argc > 1);
+	    numDisks = atoi(*(argv + 1));	// how many disks
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-md")) {
+	    ASSERT(argc > 1);
+	    mountDisk = atoi(*(argv + 1));	// which one to mount
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-su")) {
+	    ASSERT(argc > 1);
+	    stripeUnit = atoi(*(argv + 1));	// sectors per stripe unit
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-dg")) {
+	    ASSERT(argc > 4);			// the shape of the disks
+	    geometry.numTracks = atoi(*(argv + 1));
+	    geometry.sectorsPerTrack = atoi(*(argv + 2));
+	    geometry.seekTime = atoi(*(argv + 3));
+	    geometry.rotationTime = atoi(*(argv + 4));
+	    argCount = 5;
+	}
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -135,6 +184,9 @@ Initialize(int argc, char **argv)
 
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
+    schedTrace = new SchedTrace();		// record scheduler events
+    if (traceFile != NULL)			// export the timeline
+	tracer = new Tracer(traceFile);
     interrupt = new Interrupt;			// start up interrupt handling
     scheduler = new Scheduler();		// initialize the ready queue
     if (randomYield)				// start the timer (if needed)
@@ -164,10 +216,32 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
     machine = new Machine(debugUserProg);	// this must come first
     memMa = new memoryManager(NumPhysPages);
+    pipeTable = new PipeTable();
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    ASSERT(numDisks >= 1 && numDisks <= MaxDisks);
+    diskSectors = geometry.NumSectors() * ((stripeUnit > 0) ? numDisks : 1);
+    if (diskSectors > (int) MaxFileSectors) {	// no bigger than a file
+	printf("A disk of %d sectors is more than a file can hold (%d)\n",
+	       diskSectors, (int) MaxFileSectors);
+	Exit(1);
+    }
+    if (stripeUnit > 0) {		// DISK, DISK1, ... make up one disk
+	disks[0] = new SynchDisk("DISK", numDisks, stripeUnit, &geometry);
+	numDisks = 1;
+    } else
+	for (int i = 0; i < numDisks; i++) {	// DISK, DISK1, DISK2, ...
+	    if (i == 0)
+		strcpy(diskName, "DISK");
+	    else
+		sprintf(diskName, "DISK%d", i);
+	    disks[i] = new SynchDisk(diskName, 1, 1, &geometry);
+	}
+    ASSERT(mountDisk >= 0 && mountDisk < numDisks);
+    synchDisk = disks[mountDisk];
+    headerTable = new HeaderTable();
+    journal = new Journal();
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -186,6 +260,7 @@ Initialize(int argc, char **argv)
 void
 Cleanup()
 {
+    LogFlush();
     printf("\nCleaning up...\n");
 #ifdef NETWORK
     delete postOffice;
@@ -194,6 +269,7 @@ Cleanup()
 #ifdef USER_PROGRAM
     delete machine;
     delete memMa;
+    delete pipeTable;			// before the file system
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -201,10 +277,15 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
-    delete synchDisk;
+    delete headerTable;
+    delete journal;
+    for (int i = 0; i < numDisks; i++)
+	delete disks[i];
 #endif
     
     delete timer;
+    delete tracer;			// finishes the trace file
+    delete schedTrace;
     delete scheduler;
     delete interrupt;
     
@@ -17,6 +17,8 @@
 #include "stats.h"
 #include "timer.h"
 #include "synch.h"
+#include "schedtrace.h"
+#include "tracer.h"
 
 // Initialization and cleanup routines
 extern void Initialize(int argc, char **argv); 	// Initialization,
@@ -31,6 +33,10 @@ extern Scheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
+extern SchedTrace *schedTrace;			// recent scheduler events
+extern char *schedTraceFile;			// where to dump them at Halt,
+						// NULL if not wanted
+extern Tracer *tracer;				// timeline export, NULL if off
 extern bool tid_alloc[128];			//Tid pool
 extern Thread* tid_pointer[128];	//Tid pointer
 #ifdef USER_PROGRAM
@@ -38,6 +44,8 @@ extern Thread* tid_pointer[128];	//Tid pointer
 extern Machine* machine;	// user program memory and registers
 #include "memoryManager.h"
 extern memoryManager* memMa;
+#include "pipe.h"
+extern PipeTable *pipeTable;	// pipes open by user programs
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -47,7 +55,14 @@ extern FileSystem  *fileSystem;
 
 #ifdef FILESYS
 #include "synchdisk.h"
-extern SynchDisk   *synchDisk;
+#include "filehdr.h"
+#include "journal.h"
+#define MaxDisks	4		// most disks a machine can have
+extern SynchDisk   *disks[MaxDisks];	// every disk, each with its own
+extern int numDisks;			// request queue and cache
+extern SynchDisk   *synchDisk;		// the one the file system is on
+extern HeaderTable *headerTable;		// headers of open files
+extern Journal     *journal;		// metadata write-ahead log
 #endif
 
 #ifdef NETWORK
@@ -51,6 +51,16 @@ Thread::Thread(char* threadName)
         }
     }
     status = JUST_CREATED;
+    priority = basePriority = DefaultPriority;
+    waitingOn = NULL;
+    heldLocks = new List;
+    userTicks = systemTicks = readyWaitTicks = 0;
+    voluntarySwitches = involuntarySwitches = 0;
+    readySince = 0;
+    preempted = FALSE;
+#ifdef FILESYS
+    journalDepth = 0;
+#endif
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -77,6 +87,7 @@ Thread::~Thread()
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
     tid_alloc[this->tid]=false;
     tid_pointer[this->tid]=NULL;
+    delete heldLocks;
 }
 
 //----------------------------------------------------------------------
@@ -162,6 +173,7 @@ Thread::Finish ()
     ASSERT(this == currentThread);
     
     DEBUG('t', "Finishing thread \"%s\"\n", getName());
+    schedTrace->Record(SchedFinish, this, userTicks + systemTicks);
     
     threadToBeDestroyed = currentThread;
     Sleep();					// invokes SWITCH
@@ -234,6 +246,7 @@ Thread::Sleep ()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
     status = BLOCKED;
+    schedTrace->Record(SchedBlock, this, 0);
     //printf("1\n");
     while ((nextThread = scheduler->FindNextToRun()) == NULL)
 	interrupt->Idle();	// no one to run, wait for an interrupt
@@ -243,6 +256,20 @@ Thread::Sleep ()
     scheduler->Run(nextThread); // returns when we've been signalled
 }
 
+//----------------------------------------------------------------------
+// Thread::PrintAccounting
+//	Print how this thread has spent its time so far, for finding out
+//	which threads cause scheduling latency.
+//----------------------------------------------------------------------
+
+void
+Thread::PrintAccounting()
+{
+    printf("Thread %d \"%s\": user %d, system %d, ready wait %d, "
+	   "switches voluntary %d, involuntary %d\n", tid, name, userTicks,
+	   systemTicks, readyWaitTicks, voluntarySwitches, involuntarySwitches);
+}
+
 //----------------------------------------------------------------------
 // ThreadFinish, InterruptEnable, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
@@ -283,6 +310,78 @@ Thread* Thread::createThread_priority(char * debugName,int priority){
     return new_thread;
 }
 
+//----------------------------------------------------------------------
+// Thread::setpriorty
+//	Change the base priority of a thread.  Any priority it currently
+//	inherits from waiters on the locks it holds is kept.
+//
+//	"newPriority" -- the new base priority (smaller runs first)
+//----------------------------------------------------------------------
+
+void
+Thread::setpriorty(int newPriority)
+{
+    basePriority = newPriority;
+    RestorePriority();
+}
+
+//----------------------------------------------------------------------
+// Thread::DonatePriority
+//	Priority inheritance.  Called when a thread waiting for a lock
+//	held by this thread has a better priority than we do.  Raise our
+//	effective priority to "donated", and if we are in turn blocked on
+//	another lock, pass the donation along to its holder, so that a
+//	chain of locks is boosted all the way down.
+//
+//	The walk stops as soon as a holder already runs at least at
+//	"donated", which also stops it on a deadlock cycle.
+//
+//	Assumes interrupts are disabled.
+//----------------------------------------------------------------------
+
+void
+Thread::DonatePriority(int donated)
+{
+    Thread *holder = this;
+
+    ASSERT(interrupt->getLevel() == IntOff);
+    while (holder != NULL && donated < holder->priority) {
+	DEBUG('s', "Donating priority %d to thread \"%s\"\n", donated,
+	      holder->getName());
+	holder->priority = donated;
+	if (holder->status == READY)
+	    scheduler->Reposition(holder);
+	if (holder->waitingOn == NULL)
+	    break;
+	holder = holder->waitingOn->getHolder();
+    }
+}
+
+//----------------------------------------------------------------------
+// Thread::RestorePriority
+//	Recompute our effective priority after giving up a lock (or after
+//	a waiter went away): the base priority, boosted by the best waiter
+//	on any lock we still hold.
+//----------------------------------------------------------------------
+
+void
+Thread::RestorePriority()
+{
+    int best = basePriority;
+
+    for (ListElement *ptr = heldLocks->getfirst(); ptr != NULL;
+						ptr = ptr->next) {
+	int waiter = ((Lock *) ptr->item)->TopWaiterPriority();
+	if (waiter < best)
+	    best = waiter;
+    }
+    if (best != priority) {
+	priority = best;
+	if (status == READY)
+	    scheduler->Reposition(this);
+    }
+}
+
 //----------------------------------------------------------------------
 // Thread::StackAllocate
 //	Allocate and initialize an execution stack.  The stack is
@@ -61,6 +61,13 @@
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 
+// Priority given to threads created without an explicit one.
+// Smaller values run first (the ready list is sorted in increasing order).
+#define DefaultPriority	10
+
+class Lock;
+class List;
+
 
 
 // external function, dummy routine whose sole job is to call Thread::Print
@@ -85,7 +92,9 @@ class Thread {
     void *machineState[MachineStateSize];  // all registers except for stackTop
     int tid;
     int uid;
-    int priority;
+    int priority;			// effective priority, including
+					// any donated through a Lock
+    int basePriority;			// priority before donations
 
   public:
     Thread(char* debugName);		// initialize a Thread 
@@ -106,19 +115,46 @@ class Thread {
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
     char* getName() { return (name); }
     char* getVname() {return (vname);}
     void Print() { printf("%s, ", name); }
     int getTid(){return this->tid;}
     int getUid(){return this->uid;}
     int getpriorty(){return this->priority;}
-    void setpriorty(int priority){this->priority=priority;}
+    int getBasePriority(){return this->basePriority;}
+    void setpriorty(int priority);	// change the base priority
+    void DonatePriority(int donated);	// lend "donated" to this thread and
+					// to the holders of the locks it
+					// is waiting for
+    void RestorePriority();		// drop donations that are no longer
+					// backed by a waiter on a held lock
     static Thread* createThread(char* debugName);
     static Thread* createThread_priority(char* debugName,int priority);
     static int checkTidNum();
 
     char* filename;
 
+    // Per-thread CPU accounting, kept up to date by Interrupt::OneTick
+    // and the scheduler.
+    int userTicks;			// ticks spent running user code
+    int systemTicks;			// ticks spent running kernel code
+    int readyWaitTicks;			// ticks spent on the ready list
+    int voluntarySwitches;		// gave up the CPU: Yield or Sleep
+    int involuntarySwitches;		// preempted by the timer
+    int readySince;			// when we were last made ready
+    bool preempted;			// set while a timer-forced Yield
+					// is in progress
+    void PrintAccounting();		// print the counters above
+
+    Lock* waitingOn;			// lock we are blocked on, if any
+    List* heldLocks;			// locks we currently own
+
+#ifdef FILESYS
+    int journalDepth;			// metadata updates we are in the
+					// middle of (cf. Journal::Begin)
+#endif
+
   private:
     // some of the private data for this class is listed above
     
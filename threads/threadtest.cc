@@ -23,6 +23,7 @@ Semaphore* use=new Semaphore("check use",1);
 Semaphore* full=new Semaphore("check full",0);
 Semaphore* empty=new Semaphore("check empty",Maxcount);
 RWLock* rw_lock=new RWLock("reader writer lock");
+Lock* pi_lock=new Lock("priority inheritance lock");
 //----------------------------------------------------------------------
 // SimpleThread
 // 	Loop 5 times, yielding the CPU to another ready thread 
@@ -129,6 +130,41 @@ void reader(int num){
     printf("%s done.\n",currentThread->getName());
     rw_lock->Release_r();
 }
+
+void overlap_reader(int which){
+    rw_lock->Acquire_r();
+    printf("%s reading\n",currentThread->getName());
+    currentThread->Yield();		// the other reader gets in meanwhile
+    printf("%s done reading\n",currentThread->getName());
+    rw_lock->Release_r();
+}
+
+void overlap_writer(int which){
+    printf("%s wants to write\n",currentThread->getName());
+    rw_lock->Acquire_w();
+    printf("%s writing\n",currentThread->getName());
+    rw_lock->Release_w();
+}
+
+void pi_low(int which){
+    pi_lock->Acquire();
+    printf("%s holds the lock, priority %d\n",currentThread->getName(),currentThread->getpriorty());
+    currentThread->Yield();
+    printf("%s releasing the lock, priority %d\n",currentThread->getName(),currentThread->getpriorty());
+    pi_lock->Release();
+    printf("%s done, priority %d\n",currentThread->getName(),currentThread->getpriorty());
+}
+
+void pi_medium(int which){
+    printf("%s running\n",currentThread->getName());
+}
+
+void pi_high(int which){
+    printf("%s wants the lock\n",currentThread->getName());
+    pi_lock->Acquire();
+    printf("%s got the lock\n",currentThread->getName());
+    pi_lock->Release();
+}
 //----------------------------------------------------------------------
 // ThreadTest1
 // 	Set up a ping-pong between two threads, by forking a thread 
@@ -267,6 +303,42 @@ void w_r(){
     t->Fork(writer,(void*)i);
 }
 //----------------------------------------------------------------------
+// rw_overlap
+// 	Two readers hold the reader/writer lock at once, each releasing it
+//	after the other has taken it; a writer that comes along meanwhile
+//	gets it only once both are done.
+//----------------------------------------------------------------------
+
+void rw_overlap(){
+    DEBUG('t',"overlapping readers.");
+    Thread* r1 = Thread::createThread("reader 1");
+    r1->Fork(overlap_reader,0);
+    Thread* r2 = Thread::createThread("reader 2");
+    r2->Fork(overlap_reader,0);
+    Thread* w = Thread::createThread("writer");
+    w->Fork(overlap_writer,0);
+    currentThread->Yield();
+}
+//----------------------------------------------------------------------
+// pri_inherit
+// 	Priority inversion: a low priority thread holds a lock that a high
+//	priority thread needs, while a medium priority thread is ready.
+//	With priority inheritance the low thread runs (and releases the
+//	lock) before the medium one; the high thread gets the lock first.
+//----------------------------------------------------------------------
+
+void pri_inherit(){
+    DEBUG('t',"priority inheritance.");
+    Thread* low = Thread::createThread_priority("low",8);
+    low->Fork(pi_low,0);
+    currentThread->Yield();		// let "low" take the lock
+    Thread* medium = Thread::createThread_priority("medium",5);
+    medium->Fork(pi_medium,0);
+    Thread* high = Thread::createThread_priority("high",1);
+    high->Fork(pi_high,0);
+    currentThread->Yield();
+}
+//----------------------------------------------------------------------
 // ThreadTest
 // 	Invoke a test routine.
 //----------------------------------------------------------------------
@@ -305,6 +377,12 @@ ThreadTest()
     case 10:
     w_r();
     break;
+    case 11:
+    pri_inherit();
+    break;
+    case 12:
+    rw_overlap();
+    break;
     default:
 	printf("No test specified.\n");
 	break;
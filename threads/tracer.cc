@@ -0,0 +1,216 @@
+// tracer.cc
+//	Routines to write a Chrome trace-event JSON file describing the
+//	simulated timeline: which thread had the CPU when, disk requests
+//	and their latency, syscalls, page faults, TLB misses and network
+//	packets.
+//
+//	The output is a single JSON object, {"traceEvents":[ ... ]}.  Each
+//	event is formatted straight into a large memory buffer; the buffer
+//	is written to the UNIX file only when it is full, so the cost per
+//	event is one sprintf.
+
+#include "copyright.h"
+#include "tracer.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// SafeName
+// 	Copy "name" into "to", dropping anything that would have to be
+//	escaped inside a JSON string.  Thread names come from all over
+//	the place, and it is not worth doing proper escaping.
+//----------------------------------------------------------------------
+
+static char *
+SafeName(char *to, const char *name)
+{
+    int i;
+
+    for (i = 0; name[i] != '\0' && i < 63; i++)
+	if (name[i] == '"' || name[i] == '\\' || name[i] < ' ')
+	    to[i] = '_';
+	else
+	    to[i] = name[i];
+    to[i] = '\0';
+    return to;
+}
+
+//----------------------------------------------------------------------
+// Tracer::Tracer
+// 	Create the trace file, and start the JSON document.
+//
+//	"fileName" -- the UNIX file to write the trace into
+//----------------------------------------------------------------------
+
+Tracer::Tracer(char *fileName)
+{
+    fileno = OpenForWrite(fileName);
+    buffer = new char[TraceBufferSize];
+    used = sprintf(buffer, "{\"traceEvents\":[\n");
+    firstEvent = TRUE;
+    sliceStart = 0;
+    for (int i = 0; i < TraceMaxThreads; i++)
+	named[i] = FALSE;
+    NameRow(TraceDiskRow, "disk");
+    NameRow(TraceNetworkRow, "network");
+}
+
+//----------------------------------------------------------------------
+// Tracer::~Tracer
+// 	Close the run slice of the thread that is running now, finish the
+//	JSON document, and flush everything to the file.
+//----------------------------------------------------------------------
+
+Tracer::~Tracer()
+{
+    char name[64];
+
+    if (currentThread != NULL)
+	Complete("sched", SafeName(name, currentThread->getName()),
+		 currentThread->getTid(), sliceStart,
+		 stats->totalTicks - sliceStart, NULL, 0);
+    used += sprintf(buffer + used, "\n]}\n");
+    Flush();
+    Close(fileno);
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// Tracer::Reserve
+// 	Return where the next event should be formatted, flushing the
+//	buffer first if there might not be room for it.  The separator
+//	between events is already in place.
+//----------------------------------------------------------------------
+
+char *
+Tracer::Reserve()
+{
+    if (used + TraceMaxEvent >= TraceBufferSize)
+	Flush();
+    if (!firstEvent)
+	buffer[used++] = ',';
+    firstEvent = FALSE;
+    return buffer + used;
+}
+
+//----------------------------------------------------------------------
+// Tracer::Commit
+// 	The caller has formatted "length" bytes at the location returned
+//	by Reserve.
+//----------------------------------------------------------------------
+
+void
+Tracer::Commit(int length)
+{
+    ASSERT(length < TraceMaxEvent);
+    used += length;
+    buffer[used++] = '\n';
+}
+
+//----------------------------------------------------------------------
+// Tracer::Flush
+// 	Write out whatever has been buffered so far.
+//----------------------------------------------------------------------
+
+void
+Tracer::Flush()
+{
+    WriteFile(fileno, buffer, used);
+    used = 0;
+}
+
+//----------------------------------------------------------------------
+// Tracer::NameRow
+// 	Emit a metadata event giving timeline "row" a readable name.
+//----------------------------------------------------------------------
+
+void
+Tracer::NameRow(int row, const char *name)
+{
+    char safe[64];
+
+    Commit(sprintf(Reserve(), "{\"ph\":\"M\",\"name\":\"thread_name\","
+		   "\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		   row, SafeName(safe, name)));
+}
+
+//----------------------------------------------------------------------
+// Tracer::NameThread
+// 	Label the row of "thread" the first time we see its tid.
+//----------------------------------------------------------------------
+
+void
+Tracer::NameThread(Thread *thread)
+{
+    int tid = thread->getTid();
+
+    if (tid >= 0 && tid < TraceMaxThreads && !named[tid]) {
+	named[tid] = TRUE;
+	NameRow(tid, thread->getName());
+    }
+}
+
+//----------------------------------------------------------------------
+// Tracer::Switch
+// 	Called by Scheduler::Run.  Emit the slice during which oldThread
+//	had the CPU, and start timing nextThread.
+//----------------------------------------------------------------------
+
+void
+Tracer::Switch(Thread *oldThread, Thread *nextThread)
+{
+    char name[64];
+
+    NameThread(oldThread);
+    NameThread(nextThread);
+    Complete("sched", SafeName(name, oldThread->getName()),
+	     oldThread->getTid(), sliceStart, stats->totalTicks - sliceStart,
+	     "next", nextThread->getTid());
+    sliceStart = stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Tracer::Complete
+// 	Emit an event with a duration ("ph":"X").
+//
+//	"category", "name" -- how the event is shown
+//	"row" -- timeline to put it on: a tid, or one of the device rows
+//	"start", "duration" -- in ticks
+//	"argName", "argValue" -- one optional integer argument
+//----------------------------------------------------------------------
+
+void
+Tracer::Complete(const char *category, const char *name, int row,
+		 int start, int duration, const char *argName, int argValue)
+{
+    char *event = Reserve();
+    int length = sprintf(event, "{\"ph\":\"X\",\"cat\":\"%s\",\"name\":\"%s\","
+			 "\"pid\":0,\"tid\":%d,\"ts\":%d,\"dur\":%d",
+			 category, name, row, start, duration);
+
+    if (argName != NULL)
+	length += sprintf(event + length, ",\"args\":{\"%s\":%d}",
+			  argName, argValue);
+    event[length++] = '}';
+    Commit(length);
+}
+
+//----------------------------------------------------------------------
+// Tracer::Instant
+// 	Emit an event without a duration ("ph":"i"), at the current time.
+//----------------------------------------------------------------------
+
+void
+Tracer::Instant(const char *category, const char *name, int row,
+		const char *argName, int argValue)
+{
+    char *event = Reserve();
+    int length = sprintf(event, "{\"ph\":\"i\",\"s\":\"t\",\"cat\":\"%s\","
+			 "\"name\":\"%s\",\"pid\":0,\"tid\":%d,\"ts\":%d",
+			 category, name, row, stats->totalTicks);
+
+    if (argName != NULL)
+	length += sprintf(event + length, ",\"args\":{\"%s\":%d}",
+			  argName, argValue);
+    event[length++] = '}';
+    Commit(length);
+}
@@ -0,0 +1,70 @@
+// tracer.h
+//	Data structures for exporting a timeline of the simulation in the
+//	Chrome trace-event JSON format, which can be loaded into
+//	chrome://tracing or the Perfetto UI.
+//
+//	Tracing is opt-in (-tr <file>).  When it is off the global "tracer"
+//	is NULL, and every hook in the kernel and the machine emulation is
+//	a single pointer test:
+//
+//		if (tracer != NULL)
+//		    tracer->Instant("net", "send", TraceNetworkRow, "to", hdr.to);
+//
+//	All timestamps are simulated time (stats->totalTicks); one tick is
+//	shown as one microsecond.  Events are formatted into a memory
+//	buffer that is only written to the UNIX file when it fills up, and
+//	when Nachos shuts down.
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define TraceBufferSize	(64 * 1024)	// bytes of JSON buffered in memory
+#define TraceMaxEvent	256		// longest single event we format
+#define TraceMaxThreads	128		// threads are identified by tid
+
+// Timeline rows for the simulated devices; threads use their tid.
+#define TraceDiskRow	1000
+#define TraceNetworkRow	1001
+
+class Thread;
+
+class Tracer {
+  public:
+    Tracer(char *fileName);		// start a trace in UNIX file "fileName"
+    ~Tracer();				// close the last slice, finish the
+					// JSON document and close the file
+
+    void Switch(Thread *oldThread, Thread *nextThread);
+    					// end the run slice of oldThread,
+					// start one for nextThread
+    void Complete(const char *category, const char *name, int row,
+		  int start, int duration, const char *argName, int argValue);
+    					// an event that lasted "duration"
+					// ticks from "start" on timeline
+					// "row"; argName may be NULL
+    void Instant(const char *category, const char *name, int row,
+		 const char *argName, int argValue);
+					// an event at the current time
+
+    void NameRow(int row, const char *name);	// label a timeline row
+
+    void Flush();			// write the buffered events out
+
+  private:
+    int fileno;				// UNIX file being written
+    char *buffer;			// formatted events not yet written
+    int used;				// bytes used in buffer
+    bool firstEvent;			// no "," before the first event
+    int sliceStart;			// when the running thread got the CPU
+    bool named[TraceMaxThreads];	// thread rows already labelled
+
+    char *Reserve();			// room for one more event
+    void Commit(int length);		// account for the event just
+					// formatted by the caller
+    void NameThread(Thread *thread);	// label the row of a thread
+};
+
+#endif // TRACER_H
@@ -8,6 +8,7 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "system.h"
 
 // this seems to be dependent on how the compiler is configured.
 // if you have problems with va_start, try both of these alternatives
@@ -21,7 +22,13 @@
 #endif
 #endif
 
-static char *enableFlags = NULL; // controls which DEBUG messages are printed 
+bool debugFlags[128];		// controls which DEBUG messages are printed 
+
+static char logBuffer[LogBufferSize];	// LOG messages not yet written out
+static int logUsed = 0;			// bytes used in logBuffer
+static int logWindowStart[128];		// when each flag's window began
+static int logCount[128];		// messages logged in that window
+static int logSuppressed[128];		// messages dropped in that window
 
 //----------------------------------------------------------------------
 // DebugInit
@@ -37,39 +44,89 @@ static char *enableFlags = NULL; // controls which DEBUG messages are printed
 void
 DebugInit(char *flagList)
 {
-    enableFlags = flagList;
+    bool all = (strchr(flagList, '+') != 0);
+
+    for (int i = 0; i < 128; i++)
+	debugFlags[i] = all;
+    for (; *flagList != '\0'; flagList++)
+	debugFlags[*flagList & 0x7f] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// DebugPrint
+//      Print a debug message.  Like printf, except that anything still
+//	in the LOG buffer goes out first, so messages stay in order.
+//	The flag has already been checked by the DEBUG macro.
+//----------------------------------------------------------------------
+
+void 
+DebugPrint(char *format, ...)
+{
+    va_list ap;
+
+    LogFlush();
+    // You will get an unused variable message here -- ignore it.
+    va_start(ap, format);
+    vfprintf(stdout, format, ap);
+    va_end(ap);
+    fflush(stdout);
 }
 
 //----------------------------------------------------------------------
-// DebugIsEnabled
-//      Return TRUE if DEBUG messages with "flag" are to be printed.
+// DebugLog
+//      Append a message to the LOG buffer, if "flag" has not used up
+//	its LogBurst messages for the current LogWindow.  Messages over
+//	the limit are only counted; the count is logged when the next
+//	window opens.  The buffer is written out when it fills up, before
+//	any DEBUG message, and at LogFlush.
 //----------------------------------------------------------------------
 
-bool
-DebugIsEnabled(char flag)
+void 
+DebugLog(char flag, char *format, ...)
 {
-    if (enableFlags != NULL)
-       return (strchr(enableFlags, flag) != 0) 
-		|| (strchr(enableFlags, '+') != 0);
-    else
-      return FALSE;
+    int f = flag & 0x7f;
+    int now = (stats != NULL) ? stats->totalTicks : 0;
+    va_list ap;
+
+    if (now - logWindowStart[f] >= LogWindow) {
+	logWindowStart[f] = now;
+	logCount[f] = 0;
+	if (logSuppressed[f] > 0) {
+	    int suppressed = logSuppressed[f];
+
+	    logSuppressed[f] = 0;
+	    DebugLog(flag, "[%d '%c' messages suppressed]\n", suppressed, flag);
+	}
+    }
+    if (logCount[f] >= LogBurst) {
+	logSuppressed[f]++;
+	return;
+    }
+    logCount[f]++;
+
+    if (logUsed > LogBufferSize / 2)
+	LogFlush();
+    va_start(ap, format);
+    int length = vsnprintf(logBuffer + logUsed, LogBufferSize - logUsed,
+			   format, ap);
+    va_end(ap);
+    if (length >= LogBufferSize - logUsed)	// truncated
+	length = LogBufferSize - logUsed - 1;
+    if (length > 0)
+	logUsed += length;
 }
 
 //----------------------------------------------------------------------
-// DEBUG
-//      Print a debug message, if flag is enabled.  Like printf,
-//	only with an extra argument on the front.
+// LogFlush
+//      Write out whatever LOG messages are buffered.
 //----------------------------------------------------------------------
 
 void 
-DEBUG(char flag, char *format, ...)
+LogFlush()
 {
-    if (DebugIsEnabled(flag)) {
-	va_list ap;
-	// You will get an unused variable message here -- ignore it.
-	va_start(ap, format);
-	vfprintf(stdout, format, ap);
-	va_end(ap);
+    if (logUsed > 0) {
+	fwrite(logBuffer, 1, logUsed, stdout);
 	fflush(stdout);
+	logUsed = 0;
     }
 }
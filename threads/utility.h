@@ -15,6 +15,23 @@
 //   	'f' -- file system (FILESYS)
 //   	'a' -- address spaces (USER_PROGRAM)
 //   	'n' -- network emulation (NETWORK)
+//   	'v' -- TLB refills and page faults (USER_PROGRAM)
+//   	'c' -- system calls (USER_PROGRAM)
+//   	'r' -- file and directory reader/writer locks (FILESYS)
+//   	'j' -- metadata journal (FILESYS)
+//   	'D' -- defragmenter (FILESYS)
+//   	'P' -- kernel pipes (USER_PROGRAM)
+//
+//	DEBUG is a macro: when its flag is off, all it costs is one load
+//	and a branch the compiler is told is not taken; the arguments are
+//	not even evaluated.  Compiling with -DNO_DEBUG removes DEBUG, LOG
+//	and everything guarded by DebugIsEnabled altogether.
+//
+//	LOG is for messages on paths that can run very often (TLB refills,
+//	system calls, ...).  It is controlled by the same flags as DEBUG,
+//	but the messages go through a buffer, and each flag gets at most
+//	LogBurst messages every LogWindow ticks; the rest are counted and
+//	reported as suppressed.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -56,14 +73,59 @@ typedef void (*VoidNoArgFunctionPtr)();
 // Requires definition of bool, and VoidFunctionPtr
 #include "sysdep.h"				
 
+// Tell the compiler which way a branch nearly always goes.
+#ifdef __GNUC__
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+#else
+#define likely(x)	(x)
+#define unlikely(x)	(x)
+#endif
+
 // Interface to debugging routines.
 
+#define LogBurst	32		// LOG messages allowed per flag ...
+#define LogWindow	10000		// ... every this many ticks
+#define LogBufferSize	4096		// LOG output buffered before writing
+
 extern void DebugInit(char* flags);	// enable printing debug messages
 
-extern bool DebugIsEnabled(char flag); 	// Is this debug flag enabled?
+extern bool debugFlags[128];		// which flags are enabled; "+"
+					// sets all of them
+
+extern void DebugPrint(char* format, ...);	// unconditionally print a
+						// debug message
+extern void DebugLog(char flag, char* format, ...);
+					// append a message to the LOG buffer,
+					// unless "flag" is over its rate
+extern void LogFlush();			// write out buffered LOG messages
+
+#ifdef NO_DEBUG
+
+#define DebugIsEnabled(flag)	FALSE
+#define DEBUG(flag, ...)	do { } while (0)
+#define LOG(flag, ...)		do { } while (0)
+
+#else
+
+// Is this debug flag enabled?
+#define DebugIsEnabled(flag)	unlikely(debugFlags[(flag) & 0x7f])
+
+// Print debug message if flag is enabled
+#define DEBUG(flag, ...)						      \
+    do {								      \
+	if (DebugIsEnabled(flag))					      \
+	    DebugPrint(__VA_ARGS__);					      \
+    } while (0)
+
+// Log a rate-limited, buffered message if flag is enabled
+#define LOG(flag, ...)							      \
+    do {								      \
+	if (DebugIsEnabled(flag))					      \
+	    DebugLog(flag, __VA_ARGS__);				      \
+    } while (0)
 
-extern void DEBUG (char flag, char* format, ...);  	// Print debug message 
-							// if flag is enabled
+#endif // NO_DEBUG
 
 //----------------------------------------------------------------------
 // ASSERT
@@ -75,6 +137,7 @@ extern void DEBUG (char flag, char* format, ...);  	// Print debug message
 //----------------------------------------------------------------------
 #define ASSERT(condition)                                                     \
     if (!(condition)) {                                                       \
+	LogFlush();							      \
         fprintf(stderr, "Assertion failed: line %d, file \"%s\"\n",           \
                 __LINE__, __FILE__);                                          \
 	fflush(stderr);							      \
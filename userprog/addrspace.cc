@@ -265,6 +265,7 @@ void AddrSpace::RestoreState()
 #endif 
    // machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+    machine->InvalidatePageCaches();
 }
 
 void AddrSpace::CpyAddrSpace(AddrSpace* space){
@@ -8,6 +8,10 @@
 
 #include "copyright.h"
 #include "bitmap.h"
+#include "disk.h"
+
+// How many words of the map are stored in one sector of its file.
+#define WordsPerChunk	(SectorSize / sizeof(unsigned int))
 
 //----------------------------------------------------------------------
 // BitMap::BitMap
@@ -22,8 +26,12 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    summary = new unsigned int[divRoundUp(numWords, BitsInWord)];
+    numChunks = divRoundUp(numWords, WordsPerChunk);
+    dirty = new bool[numChunks];
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +41,9 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
+    delete [] summary;
+    delete [] dirty;
 }
 
 //----------------------------------------------------------------------
@@ -46,8 +56,17 @@ BitMap::~BitMap()
 void
 BitMap::Mark(int which) 
 { 
+    int word = which / BitsInWord;
+    unsigned int bit = 1 << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    if (map[word] & bit)
+	return;
+    map[word] |= bit;
+    numClear--;
+    dirty[word / WordsPerChunk] = TRUE;
+    if (map[word] == ~0U)
+	summary[word / BitsInWord] &= ~(1 << (word % BitsInWord));
 }
     
 //----------------------------------------------------------------------
@@ -60,8 +79,16 @@ BitMap::Mark(int which)
 void 
 BitMap::Clear(int which) 
 {
+    int word = which / BitsInWord;
+    unsigned int bit = 1 << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (!(map[word] & bit))
+	return;
+    map[word] &= ~bit;
+    numClear++;
+    dirty[word / WordsPerChunk] = TRUE;
+    summary[word / BitsInWord] |= 1 << (word % BitsInWord);
 }
 
 //----------------------------------------------------------------------
@@ -82,9 +109,65 @@ BitMap::Test(int which)
 	return FALSE;
 }
 
+//----------------------------------------------------------------------
+// BitMap::NextClear
+// 	Return the number of the first clear bit at or after "from", or
+//	-1 if there is none.
+//
+//	The rest of from's word is checked directly; after that, the
+//	summary tells which words have a clear bit, so at most one more
+//	word of the map is looked at.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int from)
+{
+    int word = from / BitsInWord;
+    unsigned int bits;
+
+    if (from >= numBits)
+	return -1;
+    bits = ~map[word] & (~0U << (from % BitsInWord));
+    if (bits != 0)
+	return word * BitsInWord + __builtin_ctz(bits);
+    for (word++; word < numWords; word = (word / BitsInWord + 1) * BitsInWord) {
+	bits = summary[word / BitsInWord] & (~0U << (word % BitsInWord));
+	if (bits != 0) {
+	    word = (word / BitsInWord) * BitsInWord + __builtin_ctz(bits);
+	    return word * BitsInWord + __builtin_ctz(~map[word]);
+	}
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BitMap::RunLength
+// 	Return how many consecutive bits starting at "start" are clear,
+//	counting no further than "want".
+//----------------------------------------------------------------------
+
+int
+BitMap::RunLength(int start, int want)
+{
+    int run = 0;
+    int offset, n;
+    unsigned int bits;
+
+    while (run < want && start + run < numBits) {
+	offset = (start + run) % BitsInWord;
+	bits = map[(start + run) / BitsInWord] >> offset;
+	n = (bits == 0) ? BitsInWord - offset : __builtin_ctz(bits);
+	run += n;
+	if (n < BitsInWord - offset)
+	    break;			// hit a set bit
+    }
+    return min(run, want);
+}
+
 //----------------------------------------------------------------------
 // BitMap::Find
-// 	Return the number of the first bit which is clear.
+// 	Return the number of a clear bit, searching from just after the
+//	one found last time and wrapping around at the end ("next fit").
 //	As a side effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
@@ -94,11 +177,95 @@ BitMap::Test(int which)
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    int which = NextClear(hint);
+
+    if (which == -1)
+	which = NextClear(0);
+    if (which == -1)
+	return -1;
+    Mark(which);
+    hint = (which + 1) % numBits;
+    return which;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find and allocate a run of consecutive clear bits, for callers
+//	that want their items next to each other (e.g., the sectors of
+//	a file, so that reading it sequentially does not seek).
+//
+//	If bit "goal" is clear, the run starts there, so that an existing
+//	run can be continued.  Otherwise the first run of "want" clear
+//	bits after "goal" (wrapping around at the end) is used; if there
+//	is none, the longest run there is.  At most "want" bits are set.
+//
+//	"goal" is where the caller would like the run to start
+//	"want" is how many bits the caller would like
+//	"length" is set to how many bits were actually allocated
+//
+//	If no bits are clear, return -1.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int goal, int want, int *length)
+{
+    int best = -1, bestLength = 0;
+    int start, run, end;
+    bool done = FALSE;
+
+    if (goal < 0 || goal >= numBits)
+	goal = 0;
+    for (int pass = 0; pass < 2 && !done; pass++) {
+	start = NextClear(pass == 0 ? goal : 0);
+	end = (pass == 0) ? numBits : goal;
+	for (; start != -1 && start < end; start = NextClear(start + run)) {
+	    run = RunLength(start, want);
+	    if (run > bestLength) {
+		best = start;
+		bestLength = run;
+	    }
+	    if (run == want || start == goal) {
+		done = TRUE;
+		break;
+	    }
 	}
+    }
+    for (int i = 0; i < bestLength; i++)
+	Mark(best + i);
+    *length = bestLength;
+    return best;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindFullRun
+// 	Find and allocate a run of "want" consecutive clear bits, for
+//	callers that can use nothing shorter (e.g., the defragmenter,
+//	which wants room for a whole file).  Unlike FindRun, a shorter
+//	run at "goal" does not end the search: the first run long enough
+//	at or after "goal" (wrapping around at the end) is used.
+//
+//	If there is no run that long, return -1.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindFullRun(int goal, int want)
+{
+    int start, run = 0, end;
+
+    if (goal < 0 || goal >= numBits)
+	goal = 0;
+    for (int pass = 0; pass < 2; pass++) {
+	start = NextClear(pass == 0 ? goal : 0);
+	end = (pass == 0) ? numBits : goal;
+	for (; start != -1 && start < end; start = NextClear(start + run)) {
+	    run = RunLength(start, want);
+	    if (run == want) {
+		for (int i = 0; i < want; i++)
+		    Mark(start + i);
+		return start;
+	    }
+	}
+    }
     return -1;
 }
 
@@ -111,11 +278,33 @@ BitMap::Find()
 int 
 BitMap::NumClear() 
 {
-    int count = 0;
+    return numClear;
+}
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
-    return count;
+//----------------------------------------------------------------------
+// BitMap::Recount
+// 	Set the unused bits of the last word, and recompute the summary,
+//	the count of clear bits and the search hint from the map itself.
+//	Called whenever the whole map has been replaced; the whole map is
+//	then considered dirty.
+//----------------------------------------------------------------------
+
+void
+BitMap::Recount()
+{
+    for (int i = 0; i < numChunks; i++)
+	dirty[i] = TRUE;
+    if (numBits % BitsInWord != 0)
+	map[numWords - 1] |= ~0U << (numBits % BitsInWord);
+    for (int i = 0; i < divRoundUp(numWords, BitsInWord); i++)
+	summary[i] = 0;
+    numClear = 0;
+    for (int i = 0; i < numWords; i++)
+	if (map[i] != ~0U) {
+	    numClear += BitsInWord - __builtin_popcount(map[i]);
+	    summary[i / BitsInWord] |= 1 << (i % BitsInWord);
+	}
+    hint = 0;
 }
 
 //----------------------------------------------------------------------
@@ -149,6 +338,9 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    for (int i = 0; i < numChunks; i++)
+	dirty[i] = FALSE;		// same as the disk
 }
 
 //----------------------------------------------------------------------
@@ -162,4 +354,30 @@ void
 BitMap::WriteBack(OpenFile *file)
 {
    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    for (int i = 0; i < numChunks; i++)
+	dirty[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// BitMap::WriteDirty
+// 	Store to a Nachos file only the parts of the bitmap that have
+//	changed since it was last fetched or written back, one sector of
+//	the file at a time.
+//
+//	"file" is the place to write the bitmap to
+//----------------------------------------------------------------------
+
+void
+BitMap::WriteDirty(OpenFile *file)
+{
+    int bytes = numWords * sizeof(unsigned);
+    int chunkBytes = WordsPerChunk * sizeof(unsigned);
+
+    for (int i = 0; i < numChunks; i++)
+	if (dirty[i]) {
+	    file->WriteAt((char *)map + i * chunkBytes,
+			  min(chunkBytes, bytes - i * chunkBytes),
+			  i * chunkBytes);
+	    dirty[i] = FALSE;
+	}
 }
@@ -4,6 +4,9 @@
 //
 //	Represented as an array of unsigned integers, on which we do
 //	modulo arithmetic to find the bit we are interested in.
+//	Searches look at a whole word at a time, and a second, much
+//	smaller bitmap (the "summary") records which words still have
+//	a clear bit, so that full words are skipped 32 at a time.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -41,9 +44,22 @@ class BitMap {
     void Clear(int which);  	// Clear the "nth" bit
     bool Test(int which);   	// Is the "nth" bit set?
     int Find();            	// Return the # of a clear bit, and as a side
-				// effect, set the bit. 
+				// effect, set the bit.  The search starts
+				// after the bit found last time.
 				// If no bits are clear, return -1.
-    int NumClear();		// Return the number of clear bits
+    int FindRun(int goal, int want, int *length);
+				// Find and set a run of up to "want" clear
+				// bits, starting at "goal" if it is clear
+				// or else as soon after it as possible;
+				// return where the run starts, and set
+				// *length.  If no bits are clear, return -1.
+    int FindFullRun(int goal, int want);
+				// Find and set a run of exactly "want"
+				// clear bits, the first one at or after
+				// "goal"; return where it starts, or -1 if
+				// there is no run that long.
+    int NumClear();		// Return the number of clear bits (kept
+				// up to date, so this is cheap)
 
     void Print();		// Print contents of bitmap
     
@@ -51,6 +67,9 @@ class BitMap {
     // write the bitmap to a file
     void FetchFrom(OpenFile *file); 	// fetch contents from disk 
     void WriteBack(OpenFile *file); 	// write contents to disk
+    void WriteDirty(OpenFile *file);	// write to disk only the sectors
+					// changed since the last
+					// FetchFrom/WriteBack/WriteDirty
 
   private:
     int numBits;			// number of bits in the bitmap
@@ -58,7 +77,21 @@ class BitMap {
 					// (rounded up if numBits is not a
 					//  multiple of the number of bits in
 					//  a word)
-    unsigned int *map;			// bit storage
+    unsigned int *map;			// bit storage; bits past numBits in
+					// the last word are kept set
+    unsigned int *summary;		// bit i set if map[i] has a clear bit
+    int numClear;			// number of clear bits
+    int hint;				// where Find starts looking
+    bool *dirty;			// dirty[i] if sector i of the map's
+					// file is out of date
+    int numChunks;			// sectors in the map's file
+
+    int NextClear(int from);		// first clear bit at or after "from",
+					// or -1
+    int RunLength(int start, int want);	// number of clear bits starting at
+					// "start", up to "want"
+    void Recount();			// recompute summary and numClear
+					// from map
 };
 
 #endif // BITMAP_H
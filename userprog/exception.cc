@@ -60,7 +60,7 @@ void exec(int pointer){
         }
         name[pos++]=(char)c;
     }
-    printf("name:%s\n",name);
+    LOG('c', "Exec: %s\n", name);
     OpenFile *openfile = fileSystem->Open(name);
     AddrSpace *space = new AddrSpace(openfile);
     currentThread->space = space;
@@ -108,7 +108,8 @@ ExceptionHandler(ExceptionType which)
         int vpn = (unsigned) address / PageSize;
         int offset = (unsigned) address % PageSize;
         int ppn = machine->SimpleHash(vpn);
-        printf("virtualAddr:0x%x vpn:%d ppn:%d\n",address,vpn,ppn);
+        LOG('v', "Page fault: virtualAddr:0x%x vpn:%d ppn:%d\n",
+	    address, vpn, ppn);
         OpenFile *openfile = fileSystem->Open(currentThread->getVname());
         if(!machine->pageTable[ppn].valid){
             memMa->allocate(vpn,currentThread,ppn);
@@ -130,7 +131,7 @@ ExceptionHandler(ExceptionType which)
         machine->pageTable[ppn].dirty = false;
 #endif 
     } else if((which == SyscallException) && (type==SC_Create)){
-        printf("Create\n");
+        LOG('c', "Create\n");
         //create
         int name_point = machine->ReadRegister(4);
         char name[20];
@@ -153,13 +154,13 @@ ExceptionHandler(ExceptionType which)
             }
             name[pos++]=(char)c;
         }
-        printf("%s\n",name);
+        LOG('c', "Create: %s\n", name);
         fileSystem->Create(name,128);
         //PC increase
         machine->PC_increase();
     }else if((which == SyscallException) && (type==SC_Open)){
         //open
-        printf("Open\n");
+        LOG('c', "Open\n");
         int name_point = machine->ReadRegister(4);
         char name[20];
         int pos=0;
@@ -177,33 +178,49 @@ ExceptionHandler(ExceptionType which)
         machine->PC_increase();
     }else if((which==SyscallException) && (type==SC_Close)){
         //close
-        printf("Close\n");
-        OpenFile* openfile = machine->ReadRegister(4);
-        delete openfile;
+        LOG('c', "Close\n");
+        int id = machine->ReadRegister(4);
+        if (PipeTable::IsPipe(id)) {
+            pipeTable->Close(id);
+        } else {
+            OpenFile* openfile = id;
+            delete openfile;
+        }
         machine->PC_increase();
     }else if((which==SyscallException) && (type==SC_Write)){
         //write
-        printf("Write\n");
+        LOG('c', "Write\n");
         int pointer = machine->ReadRegister(4);
         int length = machine->ReadRegister(5);
-        OpenFile* openfile = machine->ReadRegister(6);
+        int id = machine->ReadRegister(6);
         char buffer[length];
         int c;
         for(int i=0;i<length;++i){
             machine->ReadMem(pointer+i,1,&c);
             buffer[i]=(char)c;
         }
-        openfile->Write(buffer,length);
+        if (PipeTable::IsPipe(id)) {
+            pipeTable->Write(id,buffer,length);	// may wait for a reader
+        } else {
+            OpenFile* openfile = id;
+            openfile->Write(buffer,length);
+        }
         machine->PC_increase();
     }else if((which==SyscallException)&&(type==SC_Read)){
         //read
-        printf("Read\n");
+        LOG('c', "Read\n");
         int pointer = machine->ReadRegister(4);
         int length = machine->ReadRegister(5);
-        OpenFile* openfile = machine->ReadRegister(6);
+        int id = machine->ReadRegister(6);
         char buffer[length];
-        int real_length = openfile->Read(buffer,length);
-        printf("read length: %d\n",real_length);
+        int real_length;
+        if (PipeTable::IsPipe(id)) {
+            real_length = pipeTable->Read(id,buffer,length);
+        } else {
+            OpenFile* openfile = id;
+            real_length = openfile->Read(buffer,length);
+        }
+        LOG('c', "read length: %d\n", real_length);
         for(int i=0;i<real_length;++i){
             machine->WriteMem(pointer+i,1,buffer[i]);
         }
@@ -211,7 +228,7 @@ ExceptionHandler(ExceptionType which)
         machine->PC_increase();
     }else if((which==SyscallException)&&(type==SC_Exec)){
         //exec
-        printf("Exec\n");
+        LOG('c', "Exec\n");
         int pointer = machine->ReadRegister(4);
         char name[20];
         int pos=0;
@@ -230,7 +247,7 @@ ExceptionHandler(ExceptionType which)
         machine->PC_increase();
     }else if((which==SyscallException)&&(type==SC_Fork)){
         //fork
-        printf("%s fork\n",currentThread->getName());
+        LOG('c', "%s fork\n", currentThread->getName());
         int func_pointer = machine->ReadRegister(4);
         OpenFile *openfile=fileSystem->Open(currentThread->filename);
         AddrSpace *space = new AddrSpace(openfile);
@@ -242,19 +259,32 @@ ExceptionHandler(ExceptionType which)
         Thread* t=new Thread("Thread1");
         t->Fork(fork,int(temp));
         machine->PC_increase();
+    }else if((which==SyscallException)&&(type==SC_Pipe)){
+        //pipe
+        int fds = machine->ReadRegister(4);
+        int readId, writeId;
+        if (pipeTable->Create(&readId, &writeId)) {
+            LOG('c', "Pipe: %d %d\n", readId, writeId);
+            machine->WriteMem(fds, 4, readId);
+            machine->WriteMem(fds + 4, 4, writeId);
+            machine->WriteRegister(2, 0);
+        } else {
+            machine->WriteRegister(2, -1);
+        }
+        machine->PC_increase();
     }else if((which==SyscallException)&&(type==SC_Yield)){
-        printf("Yield\n");
+        LOG('c', "Yield\n");
         machine->PC_increase();
         currentThread->Yield();
     }else if((which==SyscallException)&&(type==SC_Join)){
         //join
-        printf("join\n");
+        LOG('c', "join\n");
         int tid=machine->ReadRegister(4);
         while(tid_alloc[tid])
             currentThread->Yield();
         machine->PC_increase();
     }else if((which==SyscallException)&&(type==SC_Exit)){
-        printf("Thread %s Exit\n",currentThread->getName());
+        LOG('c', "Thread %s Exit\n", currentThread->getName());
         int status = machine->ReadRegister(4);
         machine->PC_increase();
         currentThread->Finish();
@@ -29,6 +29,7 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_Pipe		11
 
 #ifndef IN_ASM
 
@@ -108,6 +109,13 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* Make a pipe: bytes written to fds[1] can be read, in order, from
+ * fds[0].  Read waits until there is something to read, and returns 0
+ * once the write end is closed and the pipe is empty.  Return 0, or -1
+ * if there are too many pipes.
+ */
+int Pipe(OpenFileId *fds);
+
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple